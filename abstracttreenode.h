@@ -25,22 +25,26 @@
 #include <QStringList>
 #include <QTextStream>
 
+// T must be derived from AbstractTreeNode<T>. No virtual functions are used
+// to keep nodes small. T implements clone() and toString() and can hide
+// childrenChanged() and fetchChildren() hooks. Children are stored by T:
+// childList() returns the list or nullptr if the node can't have children,
+// so leaves don't pay for it. T deletes its children.
 template<typename T>
 class AbstractTreeNode
 {
 public:
     explicit AbstractTreeNode(T *parent = nullptr)
         : _parent(nullptr)
-        , _children(QList<T*>())
     {
         setParent(parent);
     }
 
-    virtual ~AbstractTreeNode()
+    ~AbstractTreeNode()
     {
-        qDeleteAll(_children);
         if (_parent) {
-            _parent->_children.removeOne(reinterpret_cast<T*>(this));
+            _parent->childList()->removeOne(reinterpret_cast<T*>(this));
+            _parent->childrenChanged();
         }
     }
 
@@ -51,25 +55,34 @@ public:
             return;
         }
 
-        _parent->_children.move(this->row(), row);
+        _parent->childList()->move(this->row(), row);
+        _parent->childrenChanged();
     }
 
     inline int row() const
     {
-        return _parent ? _parent->_children.indexOf(reinterpret_cast<T*>(const_cast<AbstractTreeNode<T>*>(this))) : 0;
+        return _parent ? _parent->childList()->indexOf(reinterpret_cast<T*>(const_cast<AbstractTreeNode<T>*>(this))) : 0;
     }
 
     inline void setParent(T *newParent)
     {
         if (_parent) {
-            _parent->_children.removeOne(reinterpret_cast<T*>(this));
+            _parent->childList()->removeOne(reinterpret_cast<T*>(this));
+            _parent->childrenChanged();
+            _parent = nullptr;
         }
 
         if (newParent) {
-            newParent->_children.append(reinterpret_cast<T*>(this));
-        }
+            newParent->fetchChildren();
+            Q_ASSERT(newParent->childList());
+            if (!newParent->childList()) {
+                return;
+            }
 
-        _parent = newParent;
+            newParent->childList()->append(reinterpret_cast<T*>(this));
+            _parent = newParent;
+            newParent->childrenChanged();
+        }
     }
 
     inline T *parent() const
@@ -86,36 +99,43 @@ public:
             child->_parent->removeChild(child);
         }
 
-        child->_parent = reinterpret_cast<T*>(this);
-        _children.insert(row, child);
+        self()->fetchChildren();
+        QList<T*> *list = self()->childList();
+        Q_ASSERT(list);
+        if (!list) {
+            return;
+        }
+
+        child->_parent = self();
+        list->insert(row, child);
+        self()->childrenChanged();
     }
 
     inline void appendChild(T *child)
     {
-        Q_ASSERT(child);
-        Q_ASSERT(!child->_parent);
-
-        if (child->_parent) {
-            child->_parent->removeChild(child);
-        }
-
-        child->_parent = reinterpret_cast<T*>(this);
-        _children.append(child);
+        insertChild(childCount(), child);
     }
 
     inline void removeChild(T *child)
     {
         Q_ASSERT(child);
-        Q_ASSERT(_children.contains(child));
+        self()->fetchChildren();
+        QList<T*> *list = self()->childList();
+        Q_ASSERT(list && list->contains(child));
+        if (!list) {
+            return;
+        }
 
-        _children.removeOne(child);
+        list->removeOne(child);
+        child->_parent = nullptr;
+        self()->childrenChanged();
     }
 
     inline T *child(int row) const
     {
         Q_ASSERT(row < childCount());
         if (row < childCount()) {
-            return _children.at(row);
+            return self()->childList()->at(row);
         }
         else {
             return nullptr;
@@ -124,12 +144,15 @@ public:
 
     inline int childCount() const
     {
-        return _children.size();
+        self()->fetchChildren();
+        const QList<T*> *list = self()->childList();
+        return list ? list->size() : 0;
     }
 
     inline QList<T*> children() const
     {
-        return _children;
+        self()->fetchChildren();
+        return fetchedChildren();
     }
 
     inline T *sibling(int row) const
@@ -139,27 +162,26 @@ public:
         return _parent ? _parent->child(row) : nullptr;
     }
 
-    virtual T *clone() const = 0;
-
     QString dump(int indent = 0) const
     {
+        const QList<T*> items = children();
         QString fill(indent, QLatin1Char(' '));
         QString res;
         QTextStream ts(&res, QIODevice::WriteOnly);
         ts << fill << "{\n";
-        ts << fill << ' ' << toString() << '\n';
+        ts << fill << ' ' << self()->toString() << '\n';
         ts << fill << " this " << this << '\n';
         ts << fill << " parent " << _parent << '\n';
         ts << fill << " children ";
-        for (int i = 0; i < _children.size(); ++i) {
-            ts << _children.at(i);
-            if (i < _children.size() - 1) {
+        for (int i = 0; i < items.size(); ++i) {
+            ts << items.at(i);
+            if (i < items.size() - 1) {
                 ts << ", ";
             }
         }
         ts << "\n";
 
-        for (T *item: _children) {
+        for (T *item: items) {
             ts << item->dump(indent + 1);
             ts << "\n";
         }
@@ -168,9 +190,24 @@ public:
         return res;
     }
 
-    virtual QString toString() const = 0;
+protected:
+    // Called after a child was added, removed or moved
+    inline void childrenChanged() {}
+
+    // Called before children are accessed. Allows to create them on demand.
+    inline void fetchChildren() const {}
+
+    // Children as is, without fetching
+    inline const QList<T*> &fetchedChildren() const
+    {
+        static const QList<T*> empty;
+        const QList<T*> *list = self()->childList();
+        return list ? *list : empty;
+    }
 
 private:
+    inline T *self() { return static_cast<T*>(this); }
+    inline const T *self() const { return static_cast<const T*>(this); }
+
     T *_parent;
-    QList<T*> _children;
 };
@@ -26,6 +26,7 @@
 #include "proxystyle.h"
 
 #include <QFileOpenEvent>
+#include <QElapsedTimer>
 
 Application::Application(int &argc, char **argv)
     : QApplication(argc, argv)
@@ -34,6 +35,8 @@ Application::Application(int &argc, char **argv)
     setApplicationName(QStringLiteral("Torrent File Editor"));
     setApplicationVersion(QStringLiteral(APP_VERSION));
 
+    traceStartup("application created");
+
     setStyle(new ProxyStyle());
 
     if (QIcon::themeName().isEmpty()) {
@@ -62,3 +65,17 @@ QDateTime Application::buildDateTime()
     return QDateTime(QDate::fromString(QStringLiteral(APP_COMPILATION_DATE), Qt::DateFormat::ISODate),
                      QTime::fromString(QStringLiteral(APP_COMPILATION_TIME), Qt::DateFormat::ISODate));
 }
+
+void Application::traceStartup(const char *milestone)
+{
+    static const bool enabled = !qgetenv("TFE_STARTUP_TRACE").isEmpty();
+    static QElapsedTimer timer;
+
+    if (!enabled)
+        return;
+
+    if (!timer.isValid())
+        timer.start();
+
+    qDebug("startup: %5lld ms %s", timer.elapsed(), milestone);
+}
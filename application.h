@@ -36,6 +36,9 @@ public:
     void setMainWindow(MainWindow *mainWindow);
     static QDateTime buildDateTime();
 
+    // Prints time since the first call when TFE_STARTUP_TRACE is set
+    static void traceStartup(const char *milestone);
+
 private:
     MainWindow *_mainWindow;
 };
@@ -0,0 +1,241 @@
+/*
+ * This is an open source non-commercial project. Dear PVS-Studio, please check it.
+ * PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+ *
+ * Copyright (C) 2019  Ivan Romanov <drizt72@zoho.eu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "batch.h"
+#include "functiontask.h"
+
+#include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QSemaphore>
+#include <QSet>
+#include <QThread>
+#include <QThreadPool>
+
+#include <cstdio>
+
+namespace {
+
+bool isWildcard(const QString &arg)
+{
+    return arg.contains(QLatin1Char('*')) || arg.contains(QLatin1Char('?')) || arg.contains(QLatin1Char('['));
+}
+
+// Paths of the same file are equal
+QString fileKey(const QString &path)
+{
+    QString key = QDir::cleanPath(QFileInfo(path).absoluteFilePath());
+#if defined(Q_OS_WIN) || defined(Q_OS_MAC)
+    // Case insensitive file systems
+    key = key.toLower();
+#endif
+    return key;
+}
+
+void addFile(const QString &path, const QString &relativePath, QList<Batch::Input> &inputs, QSet<QString> &seen)
+{
+    // The same file must not be processed twice in parallel
+    QString key = fileKey(path);
+    if (seen.contains(key))
+        return;
+    seen.insert(key);
+
+    Batch::Input input;
+    input.path = path;
+    input.relativePath = relativePath;
+    inputs << input;
+}
+
+void addFile(const QString &path, QList<Batch::Input> &inputs, QSet<QString> &seen)
+{
+    addFile(path, QFileInfo(path).fileName(), inputs, seen);
+}
+
+} // namespace
+
+Batch::Batch(int threadCount)
+    : _threadCount(threadCount > 0 ? threadCount : QThread::idealThreadCount())
+    , _processed(0)
+    , _failed(0)
+    , _bytes(0)
+    , _elapsed(0)
+{
+}
+
+bool Batch::collectInputs(const QStringList &args, const QStringList &nameFilters, QList<Input> &inputs, QString *errorString)
+{
+    QSet<QString> seen;
+    for (const Input &input: inputs) {
+        seen.insert(QFileInfo(input.path).absoluteFilePath());
+    }
+
+    for (const QString &arg: args) {
+        if (arg.startsWith(QLatin1Char('@'))) {
+            QFile list(arg.mid(1));
+            if (!list.open(QIODevice::ReadOnly | QIODevice::Text)) {
+                if (errorString)
+                    *errorString = QStringLiteral("can't open list %1").arg(list.fileName());
+                return false;
+            }
+
+            while (!list.atEnd()) {
+                QString path = QString::fromLocal8Bit(list.readLine()).trimmed();
+                if (!path.isEmpty())
+                    addFile(path, inputs, seen);
+            }
+        }
+        else if (QFileInfo(arg).isDir()) {
+            QDir root(arg);
+            QDirIterator it(arg, nameFilters, QDir::Files, QDirIterator::Subdirectories);
+            while (it.hasNext()) {
+                QString path = it.next();
+                addFile(path, root.relativeFilePath(path), inputs, seen);
+            }
+        }
+        else if (isWildcard(arg)) {
+            QFileInfo pattern(arg);
+            QDir dir = pattern.dir();
+            for (const QString &name: dir.entryList(QStringList(pattern.fileName()), QDir::Files, QDir::Name)) {
+                addFile(dir.filePath(name), inputs, seen);
+            }
+        }
+        else if (QFileInfo(arg).isFile()) {
+            addFile(arg, inputs, seen);
+        }
+        else {
+            if (errorString)
+                *errorString = QStringLiteral("%1 is not exist").arg(arg);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool Batch::checkOutputs(const QList<Input> &inputs, QString *errorString)
+{
+    QHash<QString, QString> files;
+    for (const Input &input: inputs) {
+        files.insert(fileKey(input.path), input.path);
+    }
+
+    QHash<QString, QString> outputs;
+    for (const Input &input: inputs) {
+        QString key = fileKey(input.output);
+        QString error;
+        if (files.contains(key))
+            error = QStringLiteral("%1 would overwrite input %2").arg(input.path, files.value(key));
+        else if (outputs.contains(key))
+            error = QStringLiteral("%1 and %2 have the same output %3").arg(outputs.value(key), input.path, input.output);
+
+        if (!error.isEmpty()) {
+            if (errorString)
+                *errorString = error;
+            return false;
+        }
+        outputs.insert(key, input.path);
+    }
+    return true;
+}
+
+QString Batch::outputPath(const Input &input, const QString &outDir, const QString &suffix)
+{
+    if (outDir.isEmpty())
+        return input.path + suffix;
+
+    return QDir(outDir).filePath(input.relativePath + suffix);
+}
+
+void Batch::run(const QList<Input> &inputs, const Function &function)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(_threadCount);
+
+    QSemaphore freeSlots(_threadCount * 2);
+
+    for (const Input &input: inputs) {
+        freeSlots.acquire();
+        pool.start(makeTask([this, &function, input, &freeSlots]() {
+            QString errorString;
+            bool ok = function(input, &errorString);
+            finish(input, ok, errorString);
+            freeSlots.release();
+        }));
+    }
+
+    pool.waitForDone();
+    _elapsed = timer.elapsed();
+}
+
+void Batch::finish(const Input &input, bool ok, const QString &errorString)
+{
+    qint64 size = ok ? QFileInfo(input.path).size() : 0;
+
+    QMutexLocker locker(&_mutex);
+    _processed++;
+    if (ok) {
+        _bytes += size;
+    }
+    else {
+        _failed++;
+        qDebug("Error: %s: %s", qPrintable(input.path), qPrintable(errorString));
+    }
+}
+
+int Batch::threadCount() const
+{
+    return _threadCount;
+}
+
+int Batch::processed() const
+{
+    return _processed;
+}
+
+int Batch::failed() const
+{
+    return _failed;
+}
+
+qint64 Batch::bytes() const
+{
+    return _bytes;
+}
+
+qint64 Batch::elapsed() const
+{
+    return _elapsed;
+}
+
+void Batch::printSummary() const
+{
+    double seconds = qMax<qint64>(_elapsed, 1) / 1000.0;
+    fprintf(stderr, "Processed %d files, %d failed, %.1f MB in %.2f s (%.0f files/s, %.1f MB/s, %d threads)\n",
+           _processed, _failed, _bytes / 1048576.0, seconds,
+           (_processed - _failed) / seconds, _bytes / 1048576.0 / seconds, _threadCount);
+}
@@ -0,0 +1,86 @@
+/*
+ * This is an open source non-commercial project. Dear PVS-Studio, please check it.
+ * PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+ *
+ * Copyright (C) 2019  Ivan Romanov <drizt72@zoho.eu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#pragma once
+
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+
+#include <functional>
+
+// Runs a command line operation over many files on a thread pool
+class Batch
+{
+public:
+    struct Input
+    {
+        QString path;
+        // Relative to the scanned directory, or only file name
+        QString relativePath;
+        // File written for the input by commands which write one
+        QString output;
+    };
+
+    // Returns true if operation succeeded. errorString describes a failure.
+    typedef std::function<bool(const Input &input, QString *errorString)> Function;
+
+    // 0 means QThread::idealThreadCount()
+    explicit Batch(int threadCount = 0);
+
+    // Expands arguments to files. Directories are scanned recursively for
+    // nameFilters. Wildcards are matched in the file name part. @file reads
+    // a list of paths, one per line. Other arguments are plain files.
+    // A file given twice is added once.
+    static bool collectInputs(const QStringList &args, const QStringList &nameFilters, QList<Input> &inputs, QString *errorString = nullptr);
+
+    // Fails if two inputs would be written to the same file or an output
+    // would overwrite an input. Outputs of all inputs must be set first.
+    static bool checkOutputs(const QList<Input> &inputs, QString *errorString = nullptr);
+
+    // Output path under outDir or next to the input if outDir is empty
+    static QString outputPath(const Input &input, const QString &outDir, const QString &suffix);
+
+    // Blocks until all inputs are processed. No more than threads * 2
+    // inputs are in flight, so memory doesn't grow with the input count.
+    void run(const QList<Input> &inputs, const Function &function);
+
+    int threadCount() const;
+    int processed() const;
+    int failed() const;
+    qint64 bytes() const;
+    qint64 elapsed() const;
+
+    // Prints throughput and errors count to stderr. Stdout is left for results.
+    void printSummary() const;
+
+private:
+    void finish(const Input &input, bool ok, const QString &errorString);
+
+    int _threadCount;
+    int _processed;
+    int _failed;
+    qint64 _bytes;
+    qint64 _elapsed;
+    QMutex _mutex;
+};
@@ -0,0 +1,313 @@
+/*
+ * This is an open source non-commercial project. Dear PVS-Studio, please check it.
+ * PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+ *
+ * Copyright (C) 2019  Ivan Romanov <drizt72@zoho.eu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "bencodebench.h"
+#include "bencode.h"
+#include "bencodemodel.h"
+#include "corpus.h"
+
+#include <QtTest>
+#include <QBuffer>
+#include <QElapsedTimer>
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+std::atomic<quint64> allocations(0);
+
+} // namespace
+
+#ifdef __GLIBC__
+// Counts heap allocations of the whole process. Qt containers allocate
+// their data with malloc() and realloc() and operator new calls malloc()
+// too. Functions of the executable take precedence over libc ones, the
+// real allocator is called through its __libc_ entry points.
+extern "C" {
+
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void __libc_free(void *ptr);
+
+void *malloc(size_t size)
+{
+    allocations++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+    allocations++;
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    allocations++;
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr)
+{
+    __libc_free(ptr);
+}
+
+} // extern "C"
+#else
+// Without glibc only operator new calls are counted. Data of Qt containers
+// is allocated with malloc() and is not counted.
+void *operator new(std::size_t size)
+{
+    allocations++;
+    void *res = malloc(size ? size : 1);
+    if (!res)
+        throw std::bad_alloc();
+    return res;
+}
+
+void operator delete(void *ptr) noexcept
+{
+    free(ptr);
+}
+#endif
+
+namespace {
+
+// Prints throughput and allocations per iteration of QBENCHMARK
+class Measure
+{
+public:
+    explicit Measure(qint64 bytes)
+        : _bytes(bytes)
+        , _iterations(0)
+        , _allocations(allocations)
+        , _timer()
+    {
+        _timer.start();
+    }
+
+    ~Measure()
+    {
+        qint64 elapsed = _timer.nsecsElapsed();
+        if (!_iterations || !elapsed)
+            return;
+
+        double megabytes = static_cast<double>(_bytes) * _iterations / (1024 * 1024);
+        double allocated = static_cast<double>(allocations - _allocations) / _iterations;
+        qDebug("%.1f MB/s, %.0f allocations", megabytes * 1e9 / elapsed, allocated);
+    }
+
+    inline void next() { _iterations++; }
+
+private:
+    qint64 _bytes;
+    qint64 _iterations;
+    quint64 _allocations;
+    QElapsedTimer _timer;
+};
+
+QByteArray toJson(const QByteArray &raw)
+{
+    QByteArray json;
+    Bencode *bencode = Bencode::fromRaw(raw);
+    QBuffer buffer(&json);
+    buffer.open(QIODevice::WriteOnly);
+    bencode->toJson(&buffer);
+    delete bencode;
+    return json;
+}
+
+} // namespace
+
+void BencodeBench::initTestCase()
+{
+    QString errorString;
+    QVERIFY2(readCorpusRecipes(QStringLiteral(TFE_CORPUS_RECIPE), _recipes, &errorString), qPrintable(errorString));
+
+    for (const CorpusRecipe &recipe: _recipes) {
+        _documents << generateCorpus(recipe);
+    }
+}
+
+void BencodeBench::addShapes(bool torrentsOnly)
+{
+    QTest::addColumn<QByteArray>("raw");
+
+    for (int i = 0; i < _recipes.size(); ++i) {
+        if (!torrentsOnly || _recipes.at(i).type == CorpusRecipe::Type::Torrent)
+            QTest::newRow(qPrintable(_recipes.at(i).name)) << _documents.at(i);
+    }
+}
+
+void BencodeBench::fromRaw_data()
+{
+    addShapes();
+}
+
+void BencodeBench::fromRaw()
+{
+    QFETCH(QByteArray, raw);
+
+    Measure measure(raw.size());
+    QBENCHMARK {
+        delete Bencode::fromRaw(raw);
+        measure.next();
+    }
+}
+
+void BencodeBench::fromRawParallel_data()
+{
+    addShapes();
+}
+
+void BencodeBench::fromRawParallel()
+{
+    QFETCH(QByteArray, raw);
+
+    Measure measure(raw.size());
+    QBENCHMARK {
+        delete Bencode::fromRaw(raw, Bencode::ParseMode::Parallel);
+        measure.next();
+    }
+}
+
+void BencodeBench::toRaw_data()
+{
+    addShapes();
+}
+
+void BencodeBench::toRaw()
+{
+    QFETCH(QByteArray, raw);
+    Bencode *bencode = Bencode::fromRaw(raw);
+
+    Measure measure(raw.size());
+    QBENCHMARK {
+        QCOMPARE(bencode->toRaw().size(), raw.size());
+        measure.next();
+    }
+    delete bencode;
+}
+
+void BencodeBench::toJson_data()
+{
+    addShapes();
+}
+
+void BencodeBench::toJson()
+{
+    QFETCH(QByteArray, raw);
+    Bencode *bencode = Bencode::fromRaw(raw);
+
+    Measure measure(raw.size());
+    QBENCHMARK {
+        QByteArray json;
+        QBuffer buffer(&json);
+        buffer.open(QIODevice::WriteOnly);
+        bencode->toJson(&buffer);
+        measure.next();
+    }
+    delete bencode;
+}
+
+void BencodeBench::fromJson_data()
+{
+    addShapes();
+}
+
+void BencodeBench::fromJson()
+{
+    QFETCH(QByteArray, raw);
+    QByteArray json = ::toJson(raw);
+
+    Measure measure(json.size());
+    QBENCHMARK {
+        delete Bencode::fromJson(json);
+        measure.next();
+    }
+}
+
+void BencodeBench::clone_data()
+{
+    addShapes();
+}
+
+void BencodeBench::clone()
+{
+    QFETCH(QByteArray, raw);
+    Bencode *bencode = Bencode::fromRaw(raw);
+
+    Measure measure(raw.size());
+    QBENCHMARK {
+        delete bencode->clone();
+        measure.next();
+    }
+    delete bencode;
+}
+
+void BencodeBench::compare_data()
+{
+    addShapes();
+}
+
+// Equal documents are compared item by item even if fingerprints are cached
+void BencodeBench::compare()
+{
+    QFETCH(QByteArray, raw);
+    Bencode *bencode = Bencode::fromRaw(raw);
+    Bencode *other = Bencode::fromRaw(raw);
+
+    Measure measure(raw.size());
+    QBENCHMARK {
+        QVERIFY(bencode->compare(other));
+        measure.next();
+    }
+    delete bencode;
+    delete other;
+}
+
+void BencodeBench::hash_data()
+{
+    addShapes(true);
+}
+
+void BencodeBench::hash()
+{
+    QFETCH(QByteArray, raw);
+    BencodeModel model;
+    model.setRaw(raw);
+
+    Measure measure(raw.size());
+    QBENCHMARK {
+        QVERIFY(!model.hash().isEmpty());
+        measure.next();
+    }
+}
+
+#ifdef HAVE_QT5
+QTEST_GUILESS_MAIN(BencodeBench)
+#else
+QTEST_MAIN(BencodeBench)
+#endif
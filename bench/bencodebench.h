@@ -0,0 +1,69 @@
+/*
+ * This is an open source non-commercial project. Dear PVS-Studio, please check it.
+ * PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+ *
+ * Copyright (C) 2019  Ivan Romanov <drizt72@zoho.eu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#pragma once
+
+#include "corpus.h"
+
+#include <QObject>
+#include <QByteArray>
+#include <QList>
+
+// Benchmarks of the bencode core on documents of corpus.ini. Besides QTest
+// results every benchmark prints throughput and allocations per iteration.
+class BencodeBench : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void fromRaw_data();
+    void fromRaw();
+
+    void fromRawParallel_data();
+    void fromRawParallel();
+
+    void toRaw_data();
+    void toRaw();
+
+    void toJson_data();
+    void toJson();
+
+    void fromJson_data();
+    void fromJson();
+
+    void clone_data();
+    void clone();
+
+    void compare_data();
+    void compare();
+
+    void hash_data();
+    void hash();
+
+private:
+    void addShapes(bool torrentsOnly = false);
+
+    QList<CorpusRecipe> _recipes;
+    QList<QByteArray> _documents;
+};
@@ -0,0 +1,272 @@
+/*
+ * This is an open source non-commercial project. Dear PVS-Studio, please check it.
+ * PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+ *
+ * Copyright (C) 2019  Ivan Romanov <drizt72@zoho.eu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "corpus.h"
+#include "bencode.h"
+
+#include <QFile>
+#include <QSettings>
+#include <QStringList>
+
+#include <algorithm>
+
+namespace {
+
+class Generator
+{
+public:
+    explicit Generator(const CorpusRecipe &recipe)
+        : _recipe(recipe)
+        , _state(recipe.seed ? recipe.seed : 1)
+    {
+    }
+
+    Bencode *document()
+    {
+        return _recipe.type == CorpusRecipe::Type::Resume ? resume() : torrent();
+    }
+
+private:
+    typedef QList<Bencode*> Items;
+
+    // xorshift32. Must not be changed without CorpusRecipe::Version increasing.
+    quint32 next()
+    {
+        _state ^= _state << 13;
+        _state ^= _state >> 17;
+        _state ^= _state << 5;
+        return _state;
+    }
+
+    int bounded(int max)
+    {
+        return static_cast<int>(next() % static_cast<quint32>(max));
+    }
+
+    QByteArray bytes(int size)
+    {
+        QByteArray res;
+        res.resize(size);
+        for (int i = 0; i < size; ++i) {
+            res[i] = static_cast<char>(next());
+        }
+        return res;
+    }
+
+    QByteArray word()
+    {
+        QByteArray res;
+        int size = 3 + bounded(8);
+        for (int i = 0; i < size; ++i) {
+            res += static_cast<char>('a' + bounded(26));
+        }
+        return res;
+    }
+
+    qlonglong fileLength()
+    {
+        return static_cast<qlonglong>(next() % (64 * 1024 * 1024)) + 1;
+    }
+
+    static Bencode *keyed(const QByteArray &key, Bencode *value)
+    {
+        value->setKey(key);
+        return value;
+    }
+
+    // Items must have keys
+    Bencode *dictionary(Items items)
+    {
+        if (_recipe.canonical) {
+            std::sort(items.begin(), items.end(), [](const Bencode *a, const Bencode *b) {
+                return a->key() < b->key();
+            });
+        }
+        else {
+            for (int i = items.size() - 1; i > 0; --i) {
+                std::swap(items[i], items[bounded(i + 1)]);
+            }
+        }
+
+        Bencode *res = new Bencode(Bencode::Type::Dictionary);
+        for (Bencode *item: items) {
+            res->appendChild(item);
+        }
+        return res;
+    }
+
+    static QByteArray tracker(int tier, int index)
+    {
+        return QByteArray("http://tracker") + QByteArray::number(tier) + '-' + QByteArray::number(index) + QByteArray(".example.org/announce");
+    }
+
+    Bencode *announceList()
+    {
+        Bencode *res = new Bencode(Bencode::Type::List);
+        for (int tier = 0; tier < _recipe.trackerTiers; ++tier) {
+            Bencode *trackers = new Bencode(Bencode::Type::List);
+            trackers->appendChild(new Bencode(tracker(tier, 0)));
+            trackers->appendChild(new Bencode(tracker(tier, 1)));
+            res->appendChild(trackers);
+        }
+        return res;
+    }
+
+    Bencode *files()
+    {
+        Bencode *res = new Bencode(Bencode::Type::List);
+        for (int i = 0; i < _recipe.files; ++i) {
+            Bencode *path = new Bencode(Bencode::Type::List);
+            for (int level = 0; level < _recipe.pathDepth; ++level) {
+                path->appendChild(new Bencode(QByteArray("folder ") + QByteArray::number(bounded(16))));
+            }
+            path->appendChild(new Bencode(QByteArray("file ") + QByteArray::number(i) + '.' + word()));
+
+            Items file;
+            file.append(keyed("length", new Bencode(fileLength())));
+            file.append(keyed("path", path));
+            res->appendChild(dictionary(file));
+        }
+        return res;
+    }
+
+    Bencode *nested(int depth)
+    {
+        Bencode *res = nullptr;
+        for (int i = 0; i < depth; ++i) {
+            Bencode *list = new Bencode(Bencode::Type::List);
+            for (int j = 0; j < 3; ++j) {
+                list->appendChild(new Bencode(static_cast<qlonglong>(next())));
+            }
+
+            Items level;
+            level.append(keyed("integer", new Bencode(static_cast<qlonglong>(i))));
+            level.append(keyed("list", list));
+            level.append(keyed("string", new Bencode(word())));
+            if (res)
+                level.append(keyed("next", res));
+            res = dictionary(level);
+        }
+        return res;
+    }
+
+    Bencode *torrent()
+    {
+        Items info;
+        if (_recipe.files > 1)
+            info.append(keyed("files", files()));
+        else
+            info.append(keyed("length", new Bencode(fileLength())));
+        info.append(keyed("name", new Bencode(QByteArray("synthetic ") + QByteArray::number(_recipe.seed))));
+        info.append(keyed("piece length", new Bencode(static_cast<qlonglong>(_recipe.pieceLength))));
+        info.append(keyed("pieces", new Bencode(bytes(_recipe.pieces * 20))));
+
+        Items root;
+        root.append(keyed("announce", new Bencode(tracker(0, 0))));
+        if (_recipe.trackerTiers > 1)
+            root.append(keyed("announce-list", announceList()));
+        root.append(keyed("created by", new Bencode(QByteArray("tfe-corpus"))));
+        root.append(keyed("creation date", new Bencode(Q_INT64_C(1546300800) + bounded(365 * 24 * 3600))));
+        root.append(keyed("info", dictionary(info)));
+        if (_recipe.nesting > 0)
+            root.append(keyed("x-nested", nested(_recipe.nesting)));
+        return dictionary(root);
+    }
+
+    // uTorrent resume.dat with an entry for every torrent
+    Bencode *resume()
+    {
+        Items root;
+        root.append(keyed(".fileguard", new Bencode(bytes(20).toHex().toUpper())));
+        for (int i = 0; i < _recipe.files; ++i) {
+            Items entry;
+            entry.append(keyed("added_on", new Bencode(Q_INT64_C(1546300800) + bounded(365 * 24 * 3600))));
+            entry.append(keyed("caption", new Bencode(word())));
+            entry.append(keyed("completed_on", new Bencode(Q_INT64_C(1546300800) + bounded(365 * 24 * 3600))));
+            entry.append(keyed("downloaded", new Bencode(fileLength())));
+            entry.append(keyed("info", new Bencode(bytes(20))));
+            entry.append(keyed("path", new Bencode(QByteArray("C:\\Downloads\\") + word())));
+            entry.append(keyed("peers6", new Bencode(bytes(18 * (1 + bounded(10))))));
+            entry.append(keyed("prio", new Bencode(QByteArray(1 + bounded(16), '\x08'))));
+            entry.append(keyed("seedtime", new Bencode(static_cast<qlonglong>(bounded(3600)))));
+            entry.append(keyed("trackers", announceList()));
+            entry.append(keyed("uploaded", new Bencode(fileLength())));
+            root.append(keyed(QByteArray("torrent ") + QByteArray::number(i) + QByteArray(".torrent"), dictionary(entry)));
+        }
+
+        if (_recipe.nesting > 0)
+            root.append(keyed("x-nested", nested(_recipe.nesting)));
+        return dictionary(root);
+    }
+
+    const CorpusRecipe &_recipe;
+    quint32 _state;
+};
+
+} // namespace
+
+QByteArray generateCorpus(const CorpusRecipe &recipe)
+{
+    Generator generator(recipe);
+    Bencode *bencode = generator.document();
+    QByteArray res = bencode->toRaw();
+    delete bencode;
+    return res;
+}
+
+bool readCorpusRecipes(const QString &fileName, QList<CorpusRecipe> &recipes, QString *errorString)
+{
+    if (!QFile::exists(fileName)) {
+        if (errorString)
+            *errorString = QStringLiteral("Recipe file is not exist");
+        return false;
+    }
+
+    QSettings settings(fileName, QSettings::IniFormat);
+    int version = settings.value(QStringLiteral("version")).toInt();
+    if (version != CorpusRecipe::Version) {
+        if (errorString)
+            *errorString = QStringLiteral("Unsupported recipe version %1").arg(version);
+        return false;
+    }
+
+    for (const QString &group: settings.childGroups()) {
+        settings.beginGroup(group);
+
+        CorpusRecipe recipe;
+        recipe.name = group;
+        if (settings.value(QStringLiteral("type")).toString() == QLatin1String("resume"))
+            recipe.type = CorpusRecipe::Type::Resume;
+        recipe.seed = settings.value(QStringLiteral("seed"), recipe.seed).toUInt();
+        recipe.files = settings.value(QStringLiteral("files"), recipe.files).toInt();
+        recipe.pathDepth = settings.value(QStringLiteral("path-depth"), recipe.pathDepth).toInt();
+        recipe.pieces = settings.value(QStringLiteral("pieces"), recipe.pieces).toInt();
+        recipe.pieceLength = settings.value(QStringLiteral("piece-length"), recipe.pieceLength).toInt();
+        recipe.trackerTiers = settings.value(QStringLiteral("tracker-tiers"), recipe.trackerTiers).toInt();
+        recipe.canonical = settings.value(QStringLiteral("canonical"), recipe.canonical).toBool();
+        recipe.nesting = settings.value(QStringLiteral("nesting"), recipe.nesting).toInt();
+        recipes << recipe;
+
+        settings.endGroup();
+    }
+    return true;
+}
@@ -0,0 +1,77 @@
+/*
+ * This is an open source non-commercial project. Dear PVS-Studio, please check it.
+ * PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+ *
+ * Copyright (C) 2019  Ivan Romanov <drizt72@zoho.eu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <QList>
+
+// Parameters of one synthetic document. Generated data depends only on
+// the recipe, so the same recipe gives the same bytes on every platform.
+struct CorpusRecipe
+{
+    // Increase when generated data changes for the same recipe
+    static const int Version = 1;
+
+    enum class Type
+    {
+        Torrent,
+        Resume
+    };
+
+    CorpusRecipe()
+        : name()
+        , type(Type::Torrent)
+        , seed(1)
+        , files(1)
+        , pathDepth(1)
+        , pieces(1)
+        , pieceLength(256 * 1024)
+        , trackerTiers(1)
+        , canonical(true)
+        , nesting(0)
+    {
+    }
+
+    QString name;
+    Type type;
+    quint32 seed;
+    // Files of a torrent or entries of resume.dat. One file makes a single file torrent.
+    int files;
+    // Folders in every file path
+    int pathDepth;
+    int pieces;
+    int pieceLength;
+    int trackerTiers;
+    // Dictionary keys are sorted as bencode requires. Otherwise they are shuffled.
+    bool canonical;
+    // Nested dictionaries under an extra key of the root
+    int nesting;
+};
+
+// Returns raw bencode of the document
+QByteArray generateCorpus(const CorpusRecipe &recipe);
+
+// Reads all recipes from an INI file. Every group is a recipe named as
+// the group. Returns false if the file has an unknown version.
+bool readCorpusRecipes(const QString &fileName, QList<CorpusRecipe> &recipes, QString *errorString = nullptr);
@@ -0,0 +1,311 @@
+/*
+ * This is an open source non-commercial project. Dear PVS-Studio, please check it.
+ * PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+ *
+ * Copyright (C) 2019  Ivan Romanov <drizt72@zoho.eu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "hashbench.h"
+#include "worker.h"
+
+#include <QtTest>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QThread>
+
+#include <algorithm>
+
+namespace {
+
+const int PieceSizes[] = { 32 * 1024, 256 * 1024, 2 * 1024 * 1024, 16 * 1024 * 1024 };
+
+// Waits for the worker result running in another thread
+bool waitForResult(QSignalSpy &spy, int timeout)
+{
+    QElapsedTimer timer;
+    timer.start();
+    while (spy.isEmpty() && !timer.hasExpired(timeout)) {
+        QTest::qWait(1);
+    }
+    return !spy.isEmpty();
+}
+
+inline double megabytesPerSecond(qint64 bytes, qint64 nsecs)
+{
+    return nsecs ? static_cast<double>(bytes) / (1024 * 1024) * 1e9 / nsecs : 0;
+}
+
+} // namespace
+
+QString HashBench::createFile(const QString &name, qint64 size, bool sparse)
+{
+    QString fileName = QDir(_dir).filePath(name);
+    QDir().mkpath(QFileInfo(fileName).absolutePath());
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return QString();
+
+    // Sparse file has no data blocks. Reading it measures hashing only.
+    if (sparse) {
+        file.resize(size);
+    }
+    else {
+        QByteArray data;
+        data.resize(static_cast<int>(size));
+        quint32 state = static_cast<quint32>(qHash(name)) | 1;
+        for (int i = 0; i < data.size(); ++i) {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            data[i] = static_cast<char>(state);
+        }
+        file.write(data);
+    }
+
+    _createdFiles << fileName;
+    return fileName;
+}
+
+void HashBench::initTestCase()
+{
+    QString base = QString::fromLocal8Bit(qgetenv("TFE_HASHBENCH_DIR"));
+    if (base.isEmpty())
+        base = QDir::tempPath();
+    _dir = QDir(base).absoluteFilePath(QStringLiteral("tfe-hashbench-%1").arg(QCoreApplication::applicationPid()));
+    QVERIFY(QDir().mkpath(_dir));
+
+    // Per file overhead
+    QStringList &tiny = _datasets[QStringLiteral("tiny files")];
+    for (int i = 0; i < 5000; ++i) {
+        tiny << createFile(QStringLiteral("tiny/%1/%2.bin").arg(i / 100).arg(i), 1 + (i * 7919) % 4096, false);
+    }
+
+    // Hashing throughput
+    bool ok;
+    int sparseSize = qgetenv("TFE_HASHBENCH_SPARSE_MB").toInt(&ok);
+    if (!ok || sparseSize <= 0)
+        sparseSize = 256;
+    QStringList &huge = _datasets[QStringLiteral("huge sparse")];
+    for (int i = 0; i < 3; ++i) {
+        huge << createFile(QStringLiteral("huge/%1.iso").arg(i), static_cast<qint64>(sparseSize) * 1024 * 1024, true);
+    }
+
+    // Pieces are made from ends and starts of several files
+    const int deltas[] = { -4093, -1, 0, 1, 7, 4093 };
+    QStringList &mixed = _datasets[QStringLiteral("mixed")];
+    for (int i = 0; i < 64; ++i) {
+        qint64 size = static_cast<qint64>(1 + i % 16) * 256 * 1024 + deltas[i % 6];
+        mixed << createFile(QStringLiteral("mixed/%1.bin").arg(i), size, false);
+    }
+
+    for (const QStringList &files: _datasets) {
+        QVERIFY(!files.contains(QString()));
+    }
+}
+
+void HashBench::cleanupTestCase()
+{
+    for (const QString &fileName: _createdFiles) {
+        QFile::remove(fileName);
+    }
+
+    QStringList dirs;
+    for (const QString &fileName: _createdFiles) {
+        for (QString dir = QFileInfo(fileName).absolutePath(); dir.size() > _dir.size(); dir = QFileInfo(dir).absolutePath()) {
+            if (!dirs.contains(dir))
+                dirs << dir;
+        }
+    }
+
+    // Children before parents
+    std::sort(dirs.begin(), dirs.end(), [](const QString &a, const QString &b) { return a.size() > b.size(); });
+    for (const QString &dir: dirs) {
+        QDir().rmdir(dir);
+    }
+    QDir().rmdir(_dir);
+}
+
+qint64 HashBench::totalSize(const QString &dataset) const
+{
+    qint64 res = 0;
+    for (const QString &fileName: _datasets.value(dataset)) {
+        res += QFileInfo(fileName).size();
+    }
+    return res;
+}
+
+// Straightforward hashing of files concatenation
+QByteArray HashBench::referencePieces(const QString &dataset, int pieceSize)
+{
+    QString key = dataset + QLatin1Char('/') + QString::number(pieceSize);
+    if (_references.contains(key))
+        return _references.value(key);
+
+    QByteArray res;
+    QByteArray piece;
+    for (const QString &fileName: _datasets.value(dataset)) {
+        QFile file(fileName);
+        if (!file.open(QIODevice::ReadOnly))
+            return QByteArray();
+
+        while (!file.atEnd()) {
+            piece += file.read(pieceSize - piece.size());
+            if (piece.size() == pieceSize) {
+                res += QCryptographicHash::hash(piece, QCryptographicHash::Sha1);
+                piece.clear();
+            }
+        }
+    }
+
+    if (!piece.isEmpty())
+        res += QCryptographicHash::hash(piece, QCryptographicHash::Sha1);
+
+    _references.insert(key, res);
+    return res;
+}
+
+void HashBench::hash_data()
+{
+    QTest::addColumn<QString>("dataset");
+    QTest::addColumn<int>("pieceSize");
+    QTest::addColumn<int>("threads");
+
+    QList<int> threadCounts;
+    threadCounts << 1 << 2 << 4;
+    if (!threadCounts.contains(QThread::idealThreadCount()))
+        threadCounts << QThread::idealThreadCount();
+
+    for (const QString &dataset: _datasets.keys()) {
+        for (int pieceSize: PieceSizes) {
+            for (int threads: threadCounts) {
+                QString name = QStringLiteral("%1, %2 KiB, %3 threads").arg(dataset).arg(pieceSize / 1024).arg(threads);
+                QTest::newRow(qPrintable(name)) << dataset << pieceSize << threads;
+            }
+        }
+    }
+}
+
+// Worker runs in the main thread. Progress is emitted but not delivered anywhere.
+void HashBench::hash()
+{
+    QFETCH(QString, dataset);
+    QFETCH(int, pieceSize);
+    QFETCH(int, threads);
+
+    const QStringList files = _datasets.value(dataset);
+    Worker worker;
+    worker.setThreadCount(threads);
+    QSignalSpy spy(&worker, SIGNAL(resultReady(QByteArray,QString)));
+
+    QElapsedTimer timer;
+    timer.start();
+    QBENCHMARK_ONCE {
+        worker.doWork(files, pieceSize);
+    }
+    qint64 elapsed = timer.nsecsElapsed();
+
+    QCOMPARE(spy.count(), 1);
+    QVERIFY(spy.at(0).at(1).toString().isEmpty());
+    QCOMPARE(spy.at(0).at(0).toByteArray(), referencePieces(dataset, pieceSize));
+
+    qDebug("%.1f MB/s, %.1f us per file", megabytesPerSecond(totalSize(dataset), elapsed),
+           static_cast<double>(elapsed) / 1000 / files.size());
+}
+
+void HashBench::progress_data()
+{
+    QTest::addColumn<QString>("dataset");
+    QTest::addColumn<int>("threads");
+
+    for (const QString &dataset: _datasets.keys()) {
+        QTest::newRow(qPrintable(dataset + QStringLiteral(", 1 thread"))) << dataset << 1;
+        QTest::newRow(qPrintable(dataset + QStringLiteral(", ideal threads"))) << dataset << 0;
+    }
+}
+
+// Same as the GUI does. Worker has its own thread and progress is
+// delivered to the main thread. Compare with hash() results.
+void HashBench::progress()
+{
+    QFETCH(QString, dataset);
+    QFETCH(int, threads);
+
+    const int pieceSize = 256 * 1024;
+    QThread thread;
+    Worker *worker = new Worker;
+    worker->setThreadCount(threads);
+    worker->moveToThread(&thread);
+    connect(&thread, SIGNAL(finished()), worker, SLOT(deleteLater()));
+
+    QSignalSpy progressSpy(worker, SIGNAL(progress(int)));
+    QSignalSpy resultSpy(worker, SIGNAL(resultReady(QByteArray,QString)));
+    thread.start();
+
+    QElapsedTimer timer;
+    timer.start();
+    QMetaObject::invokeMethod(worker, "doWork", Qt::QueuedConnection, Q_ARG(QStringList, _datasets.value(dataset)), Q_ARG(int, pieceSize));
+    bool finished = waitForResult(resultSpy, 10 * 60 * 1000);
+    qint64 elapsed = timer.nsecsElapsed();
+
+    thread.quit();
+    thread.wait();
+
+    QVERIFY(finished);
+    QCOMPARE(resultSpy.at(0).at(0).toByteArray(), referencePieces(dataset, pieceSize));
+    qDebug("%.1f MB/s, %d progress signals", megabytesPerSecond(totalSize(dataset), elapsed), progressSpy.count());
+}
+
+// Time from cancel request to the result
+void HashBench::cancel()
+{
+    QThread thread;
+    Worker *worker = new Worker;
+    worker->setThreadCount(0);
+    worker->moveToThread(&thread);
+    connect(&thread, SIGNAL(finished()), worker, SLOT(deleteLater()));
+
+    QSignalSpy resultSpy(worker, SIGNAL(resultReady(QByteArray,QString)));
+    thread.start();
+
+    QMetaObject::invokeMethod(worker, "doWork", Qt::QueuedConnection, Q_ARG(QStringList, _datasets.value(QStringLiteral("huge sparse"))), Q_ARG(int, 256 * 1024));
+    QTest::qWait(200);
+
+    QElapsedTimer timer;
+    timer.start();
+    QMetaObject::invokeMethod(worker, "cancel", Qt::QueuedConnection);
+    bool finished = waitForResult(resultSpy, 60 * 1000);
+    qint64 elapsed = timer.nsecsElapsed();
+
+    thread.quit();
+    thread.wait();
+
+    QVERIFY(finished);
+    // Canceled work has empty result and no error
+    QVERIFY(resultSpy.at(0).at(0).toByteArray().isEmpty());
+    QVERIFY(resultSpy.at(0).at(1).toString().isEmpty());
+    qDebug("canceled in %.2f ms", static_cast<double>(elapsed) / 1000000);
+}
+
+#ifdef HAVE_QT5
+QTEST_GUILESS_MAIN(HashBench)
+#else
+QTEST_MAIN(HashBench)
+#endif
@@ -0,0 +1,59 @@
+/*
+ * This is an open source non-commercial project. Dear PVS-Studio, please check it.
+ * PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+ *
+ * Copyright (C) 2019  Ivan Romanov <drizt72@zoho.eu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QMap>
+#include <QHash>
+#include <QByteArray>
+
+// Piece hashing benchmarks of Worker. Fixtures are created in
+// TFE_HASHBENCH_DIR (use tmpfs to exclude disk) or in the temp folder.
+class HashBench : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void hash_data();
+    void hash();
+
+    void progress_data();
+    void progress();
+
+    void cancel();
+
+private:
+    QString createFile(const QString &name, qint64 size, bool sparse);
+    QByteArray referencePieces(const QString &dataset, int pieceSize);
+    qint64 totalSize(const QString &dataset) const;
+
+    QString _dir;
+    QStringList _createdFiles;
+    QMap<QString, QStringList> _datasets;
+    QHash<QString, QByteArray> _references;
+};
@@ -0,0 +1,155 @@
+/*
+ * This is an open source non-commercial project. Dear PVS-Studio, please check it.
+ * PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+ *
+ * Copyright (C) 2019  Ivan Romanov <drizt72@zoho.eu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+// Generates synthetic .torrent and resume.dat files for benchmarks and fuzzing
+
+#include "corpus.h"
+
+#include <QDir>
+#include <QFile>
+#include <QStringList>
+
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+void usage()
+{
+    printf("Usage: tfe-corpus --recipe=file.ini destdir\n"
+           "       tfe-corpus [options] dest\n"
+           "Options:\n"
+           "  --type=torrent|resume\n"
+           "  --seed=N\n"
+           "  --files=N           files of torrent or entries of resume.dat\n"
+           "  --path-depth=N\n"
+           "  --pieces=N\n"
+           "  --piece-length=N\n"
+           "  --tracker-tiers=N\n"
+           "  --nesting=N\n"
+           "  --non-canonical     shuffle dictionary keys\n");
+}
+
+bool write(const QByteArray &raw, const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly) || file.write(raw) != raw.size()) {
+        printf("Error: can't write %s\n", qPrintable(fileName));
+        return false;
+    }
+    return true;
+}
+
+bool parseOption(const QString &arg, CorpusRecipe &recipe, QString &recipeFile)
+{
+    if (arg == QLatin1String("--non-canonical")) {
+        recipe.canonical = false;
+        return true;
+    }
+
+    int equal = arg.indexOf(QLatin1Char('='));
+    if (!arg.startsWith(QLatin1String("--")) || equal == -1)
+        return false;
+
+    QString name = arg.mid(2, equal - 2);
+    QString value = arg.mid(equal + 1);
+    if (name == QLatin1String("recipe")) {
+        recipeFile = value;
+        return true;
+    }
+
+    if (name == QLatin1String("type")) {
+        if (value == QLatin1String("resume"))
+            recipe.type = CorpusRecipe::Type::Resume;
+        else if (value == QLatin1String("torrent"))
+            recipe.type = CorpusRecipe::Type::Torrent;
+        else
+            return false;
+        return true;
+    }
+
+    bool ok;
+    int number = value.toInt(&ok);
+    if (!ok || number < 0)
+        return false;
+
+    if (name == QLatin1String("seed"))
+        recipe.seed = static_cast<quint32>(number);
+    else if (name == QLatin1String("files"))
+        recipe.files = number;
+    else if (name == QLatin1String("path-depth"))
+        recipe.pathDepth = number;
+    else if (name == QLatin1String("pieces"))
+        recipe.pieces = number;
+    else if (name == QLatin1String("piece-length"))
+        recipe.pieceLength = number;
+    else if (name == QLatin1String("tracker-tiers"))
+        recipe.trackerTiers = number;
+    else if (name == QLatin1String("nesting"))
+        recipe.nesting = number;
+    else
+        return false;
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2 || !strcmp(argv[1], "--help")) {
+        usage();
+        return argc < 2 ? -1 : 0;
+    }
+
+    CorpusRecipe recipe;
+    QString recipeFile;
+    for (int i = 1; i < argc - 1; ++i) {
+        if (!parseOption(QString::fromLocal8Bit(argv[i]), recipe, recipeFile)) {
+            usage();
+            return -1;
+        }
+    }
+    QString dest = QString::fromLocal8Bit(argv[argc - 1]);
+
+    if (recipeFile.isEmpty())
+        return write(generateCorpus(recipe), dest) ? 0 : -1;
+
+    QList<CorpusRecipe> recipes;
+    QString errorString;
+    if (!readCorpusRecipes(recipeFile, recipes, &errorString)) {
+        printf("Error: %s\n", qPrintable(errorString));
+        return -1;
+    }
+
+    QDir dir(dest);
+    if (!dir.mkpath(QStringLiteral("."))) {
+        printf("Error: can't create %s\n", qPrintable(dest));
+        return -1;
+    }
+
+    for (const CorpusRecipe &item: recipes) {
+        QString suffix = item.type == CorpusRecipe::Type::Resume ? QStringLiteral(".dat") : QStringLiteral(".torrent");
+        if (!write(generateCorpus(item), dir.filePath(item.name + suffix)))
+            return -1;
+    }
+    return 0;
+}
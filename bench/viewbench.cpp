@@ -0,0 +1,240 @@
+/*
+ * This is an open source non-commercial project. Dear PVS-Studio, please check it.
+ * PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+ *
+ * Copyright (C) 2019  Ivan Romanov <drizt72@zoho.eu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "viewbench.h"
+#include "bencodemodel.h"
+#include "bencodedelegate.h"
+#include "treeview.h"
+#include "searchdlg.h"
+
+#include <QtTest>
+#include <QAbstractItemModelTester>
+#include <QCheckBox>
+#include <QGroupBox>
+#include <QHeaderView>
+#include <QLineEdit>
+#include <QRadioButton>
+#include <QTextCodec>
+
+void ViewBench::initTestCase()
+{
+    QString errorString;
+    QVERIFY2(readCorpusRecipes(QStringLiteral(TFE_CORPUS_RECIPE), _recipes, &errorString), qPrintable(errorString));
+
+    for (const CorpusRecipe &recipe: _recipes) {
+        _documents << generateCorpus(recipe);
+    }
+}
+
+// Same view setup as the tree tab of MainWindow
+void ViewBench::init()
+{
+    _model = new BencodeModel;
+    if (qgetenv("TFE_VIEWBENCH_NO_TESTER").isEmpty())
+        new QAbstractItemModelTester(_model, QAbstractItemModelTester::FailureReportingMode::QtTest, _model);
+
+    _view = new TreeView;
+    _view->setModel(_model);
+    _view->setItemDelegate(new BencodeDelegate(_view));
+    for (int i = 0; i < _model->columnCount(); ++i) {
+        _view->header()->setSectionResizeMode(i, QHeaderView::ResizeToContents);
+    }
+    _view->header()->setSectionsMovable(false);
+    _view->resize(1024, 768);
+    _view->show();
+    QVERIFY(QTest::qWaitForWindowExposed(_view));
+}
+
+void ViewBench::cleanup()
+{
+    delete _view;
+    _view = nullptr;
+    delete _model;
+    _model = nullptr;
+}
+
+void ViewBench::addDocuments()
+{
+    QTest::addColumn<QByteArray>("raw");
+
+    for (int i = 0; i < _recipes.size(); ++i) {
+        QTest::newRow(qPrintable(_recipes.at(i).name)) << _documents.at(i);
+    }
+}
+
+// Synchronous paint of the visible rows
+void ViewBench::paint()
+{
+    QCoreApplication::processEvents();
+    _view->viewport()->repaint();
+}
+
+// List or dictionary with the most rows in the top levels.
+// 100k files list or resume.dat entries.
+QModelIndex ViewBench::widestList() const
+{
+    QModelIndex res;
+    int rows = 0;
+    QModelIndexList level;
+    level << QModelIndex();
+    for (int depth = 0; depth < 4; ++depth) {
+        QModelIndexList next;
+        for (const QModelIndex &parent: level) {
+            for (int row = 0; row < qMin(_model->rowCount(parent), 100); ++row) {
+                QModelIndex index = _model->index(row, 0, parent);
+                if (_model->rowCount(index) > rows) {
+                    res = index;
+                    rows = _model->rowCount(index);
+                }
+                next << index;
+            }
+        }
+        level = next;
+    }
+    return res;
+}
+
+void ViewBench::open_data()
+{
+    addDocuments();
+}
+
+void ViewBench::open()
+{
+    QFETCH(QByteArray, raw);
+
+    QBENCHMARK_ONCE {
+        _model->setRaw(raw);
+        _view->expand(_model->index(0, 0));
+        paint();
+    }
+}
+
+void ViewBench::expandAll_data()
+{
+    addDocuments();
+}
+
+void ViewBench::expandAll()
+{
+    QFETCH(QByteArray, raw);
+    _model->setRaw(raw);
+    paint();
+
+    QBENCHMARK_ONCE {
+        _view->expandAll();
+        paint();
+    }
+}
+
+void ViewBench::scrollToBottom_data()
+{
+    addDocuments();
+}
+
+void ViewBench::scrollToBottom()
+{
+    QFETCH(QByteArray, raw);
+    _model->setRaw(raw);
+
+    QModelIndex list = widestList();
+    for (QModelIndex index = list; index.isValid(); index = index.parent()) {
+        _view->expand(index);
+    }
+    paint();
+
+    QBENCHMARK_ONCE {
+        _view->scrollTo(_model->index(_model->rowCount(list) - 1, 0, list));
+        paint();
+    }
+}
+
+void ViewBench::renameKey_data()
+{
+    addDocuments();
+}
+
+// Renamed item is moved to the end of the sorted dictionary
+void ViewBench::renameKey()
+{
+    QFETCH(QByteArray, raw);
+    _model->setRaw(raw);
+    QModelIndex root = _model->index(0, 0);
+    _view->expand(root);
+    paint();
+
+    QModelIndex index = _model->index(0, static_cast<int>(BencodeModel::Column::Name), root);
+    QBENCHMARK_ONCE {
+        QVERIFY(_model->setData(index, QStringLiteral("~renamed"), Qt::EditRole));
+        paint();
+    }
+}
+
+void ViewBench::setTextCodec_data()
+{
+    addDocuments();
+}
+
+void ViewBench::setTextCodec()
+{
+    QFETCH(QByteArray, raw);
+    _model->setRaw(raw);
+    _view->expandAll();
+    paint();
+
+    QBENCHMARK_ONCE {
+        _model->setTextCodec(QTextCodec::codecForName("Windows-1251"));
+        paint();
+    }
+}
+
+void ViewBench::replaceAll_data()
+{
+    addDocuments();
+}
+
+// Every document of the corpus has this tracker
+void ViewBench::replaceAll()
+{
+    QFETCH(QByteArray, raw);
+    _model->setRaw(raw);
+    _view->expand(_model->index(0, 0));
+    paint();
+
+    SearchDlg dlg(_model);
+    dlg.setReplaceModeEnabled(true);
+    dlg.findChild<QGroupBox*>(QStringLiteral("grpKey"))->setChecked(false);
+    dlg.findChild<QGroupBox*>(QStringLiteral("grpValue"))->setChecked(true);
+    dlg.findChild<QRadioButton*>(QStringLiteral("rdValueExactMatch"))->setChecked(true);
+    dlg.findChild<QLineEdit*>(QStringLiteral("lneValue"))->setText(QStringLiteral("http://tracker0-0.example.org/announce"));
+    dlg.findChild<QLineEdit*>(QStringLiteral("lneReplace"))->setText(QStringLiteral("http://replaced.example.org/announce"));
+    dlg.findChild<QCheckBox*>(QStringLiteral("chkHex"))->setChecked(false);
+
+    QBENCHMARK_ONCE {
+        dlg.replaceAll();
+        paint();
+    }
+
+    QVERIFY(_model->canUndo());
+}
+
+QTEST_MAIN(ViewBench)
@@ -0,0 +1,74 @@
+/*
+ * This is an open source non-commercial project. Dear PVS-Studio, please check it.
+ * PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+ *
+ * Copyright (C) 2019  Ivan Romanov <drizt72@zoho.eu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#pragma once
+
+#include "corpus.h"
+
+#include <QObject>
+#include <QByteArray>
+#include <QList>
+#include <QModelIndex>
+
+class BencodeModel;
+class TreeView;
+
+// Times tree tab operations on documents of corpus.ini. Run with
+// QT_QPA_PLATFORM=offscreen. QAbstractItemModelTester checks the model
+// meanwhile unless TFE_VIEWBENCH_NO_TESTER is set.
+class ViewBench : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+    void cleanup();
+
+    void open_data();
+    void open();
+
+    void expandAll_data();
+    void expandAll();
+
+    void scrollToBottom_data();
+    void scrollToBottom();
+
+    void renameKey_data();
+    void renameKey();
+
+    void setTextCodec_data();
+    void setTextCodec();
+
+    void replaceAll_data();
+    void replaceAll();
+
+private:
+    void addDocuments();
+    void paint();
+    QModelIndex widestList() const;
+
+    QList<CorpusRecipe> _recipes;
+    QList<QByteArray> _documents;
+    BencodeModel *_model;
+    TreeView *_view;
+};
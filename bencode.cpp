@@ -20,57 +20,1328 @@
  */
 
 #include "bencode.h"
+#include "functiontask.h"
 
 #include <QDebug>
 #include <QStringList>
+#include <QIODevice>
+#include <QHash>
+#include <QSet>
+#include <QVector>
+#include <QThread>
+#include <QThreadPool>
+#include <QScopedPointer>
+#include <QSemaphore>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <new>
+
+#ifdef __SSE2__
+# include <emmintrin.h>
+#endif
+
+// Interns dictionary keys. Well-known keys are shared by all items
+// and know whether their values are hex strings. Other keys are shared
+// within one table, so repeated keys are stored once.
+class KeyTable
+{
+public:
+    KeyTable()
+        : _keys()
+    {
+    }
+
+    QByteArray intern(const char *data, int size, bool *hex)
+    {
+        const QByteArray lookup = QByteArray::fromRawData(data, size);
+        const QHash<QByteArray, bool> &known = knownKeys();
+        auto it = known.constFind(lookup);
+        if (it != known.constEnd()) {
+            *hex = it.value();
+            return it.key();
+        }
+
+        *hex = false;
+        auto localIt = _keys.constFind(lookup);
+        if (localIt != _keys.constEnd())
+            return *localIt;
+
+        // Deep copy. Data can refer to a file mapping.
+        QByteArray key(data, size);
+        _keys.insert(key);
+        return key;
+    }
+
+    // Shared copy of a well-known key or the key itself
+    static QByteArray known(const QByteArray &key, bool *hex)
+    {
+        const QHash<QByteArray, bool> &known = knownKeys();
+        auto it = known.constFind(key);
+        *hex = it != known.constEnd() && it.value();
+        return it != known.constEnd() ? it.key() : key;
+    }
+
+    static bool isHex(const QByteArray &key)
+    {
+        return knownKeys().value(key, false);
+    }
+
+private:
+    struct KnownKey
+    {
+        const char *key;
+        bool hex;
+    };
+
+    // Keys of .torrent files, uTorrent resume.dat and libtorrent fastresume
+    static const QHash<QByteArray, bool> &knownKeys()
+    {
+        static const KnownKey keys[] = {
+            { "announce", false },
+            { "announce-list", false },
+            { "comment", false },
+            { "comment.utf-8", false },
+            { "created by", false },
+            { "creation date", false },
+            { "encoding", false },
+            { "info", false },
+            { "files", false },
+            { "length", false },
+            { "md5sum", false },
+            { "name", false },
+            { "name.utf-8", false },
+            { "path", false },
+            { "path.utf-8", false },
+            { "piece length", false },
+            { "pieces", true },
+            { "private", false },
+            { "publisher", false },
+            { "publisher.utf-8", false },
+            { "publisher-url", false },
+            { "publisher-url.utf-8", false },
+            { "source", false },
+            { "url-list", false },
+            { "httpseeds", false },
+            { "nodes", false },
+            { "originator", true },
+            { "certificate", true },
+            { "signature", true },
+            { "signatures", false },
+            { ".fileguard", false },
+            { "added_on", false },
+            { "bitfield", false },
+            { "blocksize", false },
+            { "caption", false },
+            { "codec", false },
+            { "completed_on", false },
+            { "corrupt", false },
+            { "dht", false },
+            { "downloaded", false },
+            { "downspeed", false },
+            { "eta_ts", false },
+            { "have", false },
+            { "label", false },
+            { "labels", false },
+            { "last_active", false },
+            { "max_connections", false },
+            { "peers", false },
+            { "prio", false },
+            { "rootdir", false },
+            { "runtime", false },
+            { "seedtime", false },
+            { "started", false },
+            { "time", false },
+            { "trackers", false },
+            { "updated", false },
+            { "uploaded", false },
+            { "upspeed", false },
+            { "url", false },
+            { "visible", false },
+            { "active_time", false },
+            { "auto_managed", false },
+            { "file-format", false },
+            { "file-version", false },
+            { "file_priority", false },
+            { "info-hash", false },
+            { "mapped_files", false },
+            { "num_downloaders", false },
+            { "num_seeds", false },
+            { "paused", false },
+            { "piece_priority", false },
+            { "save_path", false },
+            { "seeding_time", false },
+            { "total_downloaded", false },
+            { "total_uploaded", false }
+        };
+
+        // Thread safe since C++11
+        static const QHash<QByteArray, bool> table = [] {
+            QHash<QByteArray, bool> res;
+            for (const KnownKey &key: keys) {
+                res.insert(QByteArray::fromRawData(key.key, static_cast<int>(strlen(key.key))), key.hex);
+            }
+            return res;
+        }();
+        return table;
+    }
+
+    QSet<QByteArray> _keys;
+};
+
+namespace {
+
+// Two independent 64 bit lanes. Different fingerprints mean different
+// subtrees. Equal ones still have to be confirmed by compareContent().
+const quint64 FingerprintSeed = Q_UINT64_C(0xcbf29ce484222325);
+const quint64 FingerprintSeed2 = Q_UINT64_C(0x6c62272e07bb0142);
+const quint64 FingerprintPrime = Q_UINT64_C(0x100000001b3);
+const quint64 FingerprintPrime2 = Q_UINT64_C(0xc2b2ae3d27d4eb4f);
+
+inline quint64 mixLane(quint64 hash, quint64 value, quint64 multiplier)
+{
+    value *= multiplier;
+    value ^= value >> 33;
+    hash ^= value + Q_UINT64_C(0x9e3779b97f4a7c15) + (hash << 6) + (hash >> 2);
+    return hash;
+}
+
+inline void mixFingerprint(Bencode::Fingerprint &hash, quint64 value)
+{
+    hash.low = mixLane(hash.low, value, Q_UINT64_C(0xff51afd7ed558ccd));
+    hash.high = mixLane(hash.high, value, Q_UINT64_C(0xc4ceb9fe1a85ec53));
+}
+
+inline void mixFingerprint(Bencode::Fingerprint &hash, const Bencode::Fingerprint &value)
+{
+    mixFingerprint(hash, value.low);
+    mixFingerprint(hash, value.high);
+}
+
+// Takes 8 bytes per step. Fast enough for pieces of huge torrents.
+void hashBytes(Bencode::Fingerprint &hash, const QByteArray &data)
+{
+    const char *p = data.constData();
+    int size = data.size();
+
+    mixFingerprint(hash, static_cast<quint64>(size));
+    while (size >= 8) {
+        quint64 word;
+        memcpy(&word, p, 8);
+        hash.low = (hash.low ^ word) * FingerprintPrime;
+        hash.low ^= hash.low >> 29;
+        hash.high = (hash.high ^ (word >> 32 | word << 32)) * FingerprintPrime2;
+        hash.high ^= hash.high >> 31;
+        p += 8;
+        size -= 8;
+    }
+
+    quint64 tail = 0;
+    memcpy(&tail, p, size);
+    mixFingerprint(hash, tail);
+}
+
+bool keyLessThan(const Bencode *left, const Bencode *right)
+{
+    return left->key() < right->key();
+}
+
+inline int hexValue(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+// Standard alphabet, padded to 4 characters. QByteArray::fromBase64()
+// silently skips wrong characters, so JSON input is checked first.
+bool isBase64(const QByteArray &data)
+{
+    if (data.size() % 4)
+        return false;
+
+    int padding = 0;
+    while (padding < 2 && padding < data.size() && data.at(data.size() - 1 - padding) == '=')
+        padding++;
+
+    for (int i = 0; i < data.size() - padding; i++) {
+        char c = data.at(i);
+        if (!((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '+' || c == '/'))
+            return false;
+    }
+    return true;
+}
+
+const char HexDigits[] = "0123456789abcdef";
+
+// Printable ASCII except '%' is kept as is in %HH escaped strings.
+// JSON strings also need to escape '"' and '\\'.
+template<bool Json>
+inline bool isPlain(uchar c)
+{
+    return c >= ' ' && c <= '~' && c != '%' && (!Json || (c != '"' && c != '\\'));
+}
+
+#ifdef __SSE2__
+// __SSE2__ is defined only by GCC and Clang, builtins are available.
+// Both are single instructions on the mostly non-printable pieces.
+inline int popCount(uint value)
+{
+    return __builtin_popcount(value);
+}
+
+// value must not be 0
+inline int lowestBit(uint value)
+{
+    return __builtin_ctz(value);
+}
+
+// Bit is set for each of 16 bytes which is not plain
+template<bool Json>
+inline uint escapeMask(const char *p)
+{
+    const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    // Signed compare. Bytes above 0x7f are negative.
+    __m128i plain = _mm_and_si128(_mm_cmpgt_epi8(bytes, _mm_set1_epi8(0x1f)), _mm_cmplt_epi8(bytes, _mm_set1_epi8(0x7f)));
+    __m128i special = _mm_cmpeq_epi8(bytes, _mm_set1_epi8('%'));
+    if (Json) {
+        special = _mm_or_si128(special, _mm_cmpeq_epi8(bytes, _mm_set1_epi8('"')));
+        special = _mm_or_si128(special, _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\\')));
+    }
+    plain = _mm_andnot_si128(special, plain);
+    return ~static_cast<uint>(_mm_movemask_epi8(plain)) & 0xffff;
+}
+#endif
+
+// Number of bytes which need to be escaped
+template<bool Json>
+int escapedCount(const char *p, int size)
+{
+    int count = 0;
+    int i = 0;
+#ifdef __SSE2__
+    for (; i + 16 <= size; i += 16)
+        count += popCount(escapeMask<Json>(p + i));
+#endif
+    for (; i < size; i++) {
+        if (!isPlain<Json>(static_cast<uchar>(p[i])))
+            count++;
+    }
+    return count;
+}
+
+// Length of leading plain bytes
+template<bool Json>
+int plainLength(const char *p, int size)
+{
+    int i = 0;
+#ifdef __SSE2__
+    for (; i + 16 <= size; i += 16) {
+        uint mask = escapeMask<Json>(p + i);
+        if (mask)
+            return i + lowestBit(mask);
+    }
+#endif
+    while (i < size && isPlain<Json>(static_cast<uchar>(p[i])))
+        i++;
+    return i;
+}
+
+// Latin1 to UTF-16
+inline void widen(const char *p, int size, ushort *out)
+{
+    int i = 0;
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= size; i += 16) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_unpacklo_epi8(bytes, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 8), _mm_unpackhi_epi8(bytes, zero));
+    }
+#endif
+    for (; i < size; i++)
+        out[i] = static_cast<uchar>(p[i]);
+}
+
+// Replaces %HH with byte in place. Plain runs are moved by memmove.
+void percentDecode(QByteArray &string)
+{
+    const char *percent = static_cast<const char*>(memchr(string.constData(), '%', string.size()));
+    if (!percent)
+        return;
+
+    int size = string.size();
+    char *data = string.data();
+    int out = static_cast<int>(percent - string.constData());
+    int i = out;
+    while (i < size) {
+        int high;
+        int low;
+        if (i + 2 < size && (high = hexValue(data[i + 1])) >= 0 && (low = hexValue(data[i + 2])) >= 0) {
+            data[out++] = static_cast<char>(high << 4 | low);
+            i += 3;
+        }
+        else {
+            // Not an escape. Keep '%' as is.
+            data[out++] = data[i++];
+        }
+
+        const char *next = static_cast<const char*>(memchr(data + i, '%', size - i));
+        int run = next ? static_cast<int>(next - data) - i : size - i;
+        memmove(data + out, data + i, run);
+        out += run;
+        i += run;
+    }
+    string.truncate(out);
+}
 
-QStringList hexKeys
+// Single pass JSON reader which builds Bencode items directly.
+// Strings are treated as Latin1 with %HH escaped bytes
+// like Bencode::toJson() makes them.
+class JsonReader
 {
-    QStringLiteral("pieces"),
-    QStringLiteral("originator"),
-    QStringLiteral("certificate"),
-    QStringLiteral("signature")
+public:
+    explicit JsonReader(const QByteArray &json)
+        : _begin(json.constData())
+        , _end(json.constData() + json.size())
+        , _p(json.constData())
+        , _errorOffset(-1)
+        , _errorString()
+        , _keys()
+    {
+    }
+
+    Bencode *read()
+    {
+        skipSpaces();
+        if (_p == _end || (*_p != '{' && *_p != '[')) {
+            setError(QObject::tr("document must be an object or an array"), _p);
+            return nullptr;
+        }
+
+        Bencode *res = readValue();
+        if (res) {
+            skipSpaces();
+            if (_p != _end) {
+                setError(QObject::tr("garbage at the end of the document"), _p);
+                delete res;
+                res = nullptr;
+            }
+        }
+        return res;
+    }
+
+    inline int errorOffset() const { return _errorOffset; }
+    inline QString errorString() const { return _errorString; }
+
+private:
+    inline void skipSpaces()
+    {
+        while (_p < _end && (*_p == ' ' || *_p == '\n' || *_p == '\r' || *_p == '\t'))
+            ++_p;
+    }
+
+    bool setError(const QString &errorString, const char *pos)
+    {
+        if (_errorOffset == -1) {
+            _errorString = errorString;
+            _errorOffset = static_cast<int>(pos - _begin);
+        }
+        return false;
+    }
+
+    Bencode *readValue()
+    {
+        if (_p == _end) {
+            setError(QObject::tr("unexpected end of the document"), _p);
+            return nullptr;
+        }
+
+        switch (*_p) {
+        case '{':
+            return readObject();
+
+        case '[':
+            return readArray();
+
+        case '"': {
+            QByteArray string;
+            return readString(string) ? new Bencode(string) : nullptr; }
+
+        case 't':
+        case 'f':
+        case 'n':
+            setError(QObject::tr("booleans and nulls are not supported"), _p);
+            return nullptr;
+
+        default:
+            if (*_p == '-' || (*_p >= '0' && *_p <= '9'))
+                return readNumber();
+
+            setError(QObject::tr("illegal value"), _p);
+            return nullptr;
+        }
+    }
+
+    // {"$hex": "..."} and {"$base64": "..."} are binary strings.
+    // Genuine keys which look like markers are escaped as "%24" by JsonWriter.
+    bool isBlobMarker(const char *marker) const
+    {
+        int size = static_cast<int>(strlen(marker));
+        return _end - _p >= size && !memcmp(_p, marker, size);
+    }
+
+    Bencode *readBlob(bool hex)
+    {
+        QByteArray key;
+        readString(key);
+        skipSpaces();
+        if (_p == _end || *_p != ':') {
+            setError(QObject::tr("missing colon"), _p);
+            return nullptr;
+        }
+        ++_p;
+        skipSpaces();
+
+        const char *valuePos = _p;
+        QByteArray data;
+        if (_p == _end || *_p != '"' || !readString(data)) {
+            setError(QObject::tr("blob must be a string"), valuePos);
+            return nullptr;
+        }
+
+        if (hex) {
+            for (char c: data) {
+                if (hexValue(c) < 0) {
+                    setError(QObject::tr("illegal hex string"), valuePos);
+                    return nullptr;
+                }
+            }
+
+            if (data.size() % 2) {
+                setError(QObject::tr("illegal hex string"), valuePos);
+                return nullptr;
+            }
+        }
+        else if (!isBase64(data)) {
+            setError(QObject::tr("illegal base64 string"), valuePos);
+            return nullptr;
+        }
+
+        skipSpaces();
+        if (_p == _end || *_p != '}') {
+            setError(QObject::tr("blob object must have only one key"), _p);
+            return nullptr;
+        }
+        ++_p;
+
+        Bencode *res = new Bencode(hex ? QByteArray::fromHex(data) : QByteArray::fromBase64(data));
+        res->setHex(true);
+        return res;
+    }
+
+    Bencode *readObject()
+    {
+        ++_p;
+        QList<Bencode*> items;
+        bool ok = true;
+
+        skipSpaces();
+        if (isBlobMarker("\"$hex\""))
+            return readBlob(true);
+
+        if (isBlobMarker("\"$base64\""))
+            return readBlob(false);
+
+        if (_p < _end && *_p == '}') {
+            ++_p;
+        }
+        else {
+            forever {
+                skipSpaces();
+                if (_p == _end || *_p != '"') {
+                    ok = setError(QObject::tr("missing object key"), _p);
+                    break;
+                }
+
+                QByteArray key;
+                if (!readString(key)) {
+                    ok = false;
+                    break;
+                }
+
+                skipSpaces();
+                if (_p == _end || *_p != ':') {
+                    ok = setError(QObject::tr("missing colon"), _p);
+                    break;
+                }
+                ++_p;
+                skipSpaces();
+
+                Bencode *item = readValue();
+                if (!item) {
+                    ok = false;
+                    break;
+                }
+
+                bool hex;
+                item->setKey(_keys.intern(key.constData(), key.size(), &hex));
+                if (hex)
+                    item->setHex(true);
+                items.append(item);
+
+                skipSpaces();
+                if (_p < _end && *_p == ',') {
+                    ++_p;
+                    continue;
+                }
+
+                if (_p < _end && *_p == '}') {
+                    ++_p;
+                    break;
+                }
+
+                ok = setError(QObject::tr("missing comma or closing brace"), _p);
+                break;
+            }
+        }
+
+        if (!ok) {
+            qDeleteAll(items);
+            return nullptr;
+        }
+
+        // Sort once instead of inserting each item to its place
+        std::stable_sort(items.begin(), items.end(), keyLessThan);
+
+        Bencode *res = new Bencode(Bencode::Dictionary);
+        for (int i = 0; i < items.size(); i++) {
+            // The last duplicated key wins like in QVariantMap
+            if (i + 1 < items.size() && items.at(i)->key() == items.at(i + 1)->key()) {
+                delete items.at(i);
+                continue;
+            }
+            res->appendChild(items.at(i));
+        }
+        return res;
+    }
+
+    Bencode *readArray()
+    {
+        ++_p;
+        Bencode *res = new Bencode(Bencode::List);
+
+        skipSpaces();
+        if (_p < _end && *_p == ']') {
+            ++_p;
+            return res;
+        }
+
+        forever {
+            skipSpaces();
+            Bencode *item = readValue();
+            if (!item)
+                break;
+
+            res->appendChild(item);
+
+            skipSpaces();
+            if (_p < _end && *_p == ',') {
+                ++_p;
+                continue;
+            }
+
+            if (_p < _end && *_p == ']') {
+                ++_p;
+                return res;
+            }
+
+            setError(QObject::tr("missing comma or closing bracket"), _p);
+            break;
+        }
+
+        delete res;
+        return nullptr;
+    }
+
+    bool readString(QByteArray &res)
+    {
+        const char *quote = _p;
+        const char *begin = ++_p;
+        bool escaped = false;
+        bool percent = false;
+
+        while (_p < _end && *_p != '"') {
+            if (static_cast<uchar>(*_p) < 0x20)
+                return setError(QObject::tr("illegal character in string"), _p);
+
+            if (*_p == '\\') {
+                escaped = true;
+                ++_p;
+            }
+            else if (*_p == '%') {
+                percent = true;
+            }
+            ++_p;
+        }
+
+        if (_p >= _end) {
+            _p = _end;
+            return setError(QObject::tr("unterminated string"), quote);
+        }
+
+        const char *stringEnd = _p++;
+        if (!escaped) {
+            res = QByteArray(begin, static_cast<int>(stringEnd - begin));
+        }
+        else {
+            res.reserve(static_cast<int>(stringEnd - begin));
+            for (const char *p = begin; p < stringEnd; ++p) {
+                if (*p != '\\') {
+                    res += *p;
+                    continue;
+                }
+
+                ++p;
+                switch (*p) {
+                case '"':
+                case '\\':
+                case '/':
+                    res += *p;
+                    break;
+
+                case 'b': res += '\b'; break;
+                case 'f': res += '\f'; break;
+                case 'n': res += '\n'; break;
+                case 'r': res += '\r'; break;
+                case 't': res += '\t'; break;
+
+                case 'u': {
+                    uint code = 0;
+                    for (int i = 1; i <= 4; i++) {
+                        int digit = p + i < stringEnd ? hexValue(p[i]) : -1;
+                        if (digit < 0)
+                            return setError(QObject::tr("illegal unicode escape sequence"), p - 1);
+                        code = code << 4 | static_cast<uint>(digit);
+                    }
+                    p += 4;
+
+                    // Same as QString::toLatin1()
+                    res += code <= 0xff ? static_cast<char>(code) : '?';
+                    break; }
+
+                default:
+                    return setError(QObject::tr("illegal escape sequence"), p - 1);
+                }
+            }
+
+            // '%' can be escaped as \u0025 too
+            percent = res.contains('%');
+        }
+
+        if (percent)
+            percentDecode(res);
+
+        return true;
+    }
+
+    Bencode *readNumber()
+    {
+        const char *begin = _p;
+        bool negative = *_p == '-';
+        if (negative)
+            ++_p;
+
+        if (_p == _end || *_p < '0' || *_p > '9') {
+            setError(QObject::tr("illegal number"), begin);
+            return nullptr;
+        }
+
+        // Integers are parsed exactly. Doubles are used only for fractions and overflows.
+        const quint64 limit = negative ? Q_UINT64_C(9223372036854775808) : Q_UINT64_C(9223372036854775807);
+        quint64 value = 0;
+        bool overflow = false;
+        while (_p < _end && *_p >= '0' && *_p <= '9') {
+            quint64 digit = static_cast<quint64>(*_p - '0');
+            if (value > (limit - digit) / 10)
+                overflow = true;
+            else
+                value = value * 10 + digit;
+            ++_p;
+        }
+
+        bool fraction = false;
+        if (_p < _end && *_p == '.') {
+            fraction = true;
+            ++_p;
+            while (_p < _end && *_p >= '0' && *_p <= '9')
+                ++_p;
+        }
+
+        if (_p < _end && (*_p == 'e' || *_p == 'E')) {
+            fraction = true;
+            ++_p;
+            if (_p < _end && (*_p == '+' || *_p == '-'))
+                ++_p;
+            while (_p < _end && *_p >= '0' && *_p <= '9')
+                ++_p;
+        }
+
+        if (!fraction && !overflow) {
+            qlonglong integer = negative ? static_cast<qlonglong>(0 - value) : static_cast<qlonglong>(value);
+            return new Bencode(integer);
+        }
+
+        bool ok;
+        double number = QByteArray(begin, static_cast<int>(_p - begin)).toDouble(&ok);
+        if (!ok) {
+            setError(QObject::tr("illegal number"), begin);
+            return nullptr;
+        }
+
+        qlonglong integer;
+        if (number >= 9223372036854775807.0)
+            integer = std::numeric_limits<qlonglong>::max();
+        else if (number <= -9223372036854775808.0)
+            integer = std::numeric_limits<qlonglong>::min();
+        else
+            integer = static_cast<qlonglong>(number);
+        return new Bencode(integer);
+    }
+
+    const char *_begin;
+    const char *_end;
+    const char *_p;
+
+    int _errorOffset;
+    QString _errorString;
+
+    KeyTable _keys;
 };
 
+} // namespace
+
+// Writes JSON in the same format as QJsonDocument does but without
+// intermediate QVariant. Output is flushed to the device by small chunks.
+class JsonWriter
+{
+public:
+    JsonWriter(QIODevice *device, Bencode::JsonFormat format, Bencode::BlobEncoding blobEncoding)
+        : _device(device)
+        , _indented(format == Bencode::JsonFormat::Indented)
+        , _blobEncoding(blobEncoding)
+        , _buffer()
+        , _level(0)
+        , _first(true)
+        , _afterKey(false)
+        , _ok(true)
+    {
+        _buffer.reserve(BufferSize + 64);
+    }
+
+    // Writes a part of the container items to memory. Part is
+    // appended to the container writer later.
+    JsonWriter(const JsonWriter &container, bool first)
+        : _device(nullptr)
+        , _indented(container._indented)
+        , _blobEncoding(container._blobEncoding)
+        , _buffer()
+        , _level(container._level)
+        , _first(first)
+        , _afterKey(false)
+        , _ok(true)
+    {
+    }
+
+    QByteArray take()
+    {
+        QByteArray res = _buffer;
+        _buffer = QByteArray();
+        return res;
+    }
+
+    void append(const QByteArray &part)
+    {
+        if (part.isEmpty())
+            return;
+
+        flush();
+        if (_ok && _device->write(part) != part.size())
+            _ok = false;
+        _first = false;
+    }
+
+    void beginDictionary() { beginContainer('{'); }
+    void endDictionary() { endContainer('}'); }
+    void beginList() { beginContainer('['); }
+    void endList() { endContainer(']'); }
+
+    void key(const QByteArray &key)
+    {
+        beginItem();
+        // Genuine keys can't be mixed up with blob markers. Other "$" keys
+        // are escaped only if blobs are written.
+        if (key.startsWith('$') && (_blobEncoding != Bencode::BlobEncoding::Escaped || key == "$hex" || key == "$base64")) {
+            _buffer += "\"%24";
+            writeStringContent(key.constData() + 1, key.size() - 1);
+            _buffer += '"';
+        }
+        else {
+            writeString(key);
+        }
+        _buffer += _indented ? ": " : ":";
+        _afterKey = true;
+    }
+
+    void string(const QByteArray &string)
+    {
+        beginItem();
+        writeString(string);
+    }
+
+    // Binary string. Written as {"$hex": "..."} or {"$base64": "..."} if enabled.
+    void blob(const QByteArray &blob)
+    {
+        if (_blobEncoding == Bencode::BlobEncoding::Escaped) {
+            string(blob);
+            return;
+        }
+
+        bool hex = _blobEncoding == Bencode::BlobEncoding::Hex;
+        beginDictionary();
+        beginItem();
+        _buffer += hex ? "\"$hex\"" : "\"$base64\"";
+        _buffer += _indented ? ": " : ":";
+        _afterKey = true;
+
+        beginItem();
+        _buffer += '"';
+        // Base64 chunk must be multiple of 3 bytes
+        const int chunkSize = hex ? 16 * 1024 : 3 * 5 * 1024;
+        for (int pos = 0; pos < blob.size(); pos += chunkSize) {
+            QByteArray chunk = QByteArray::fromRawData(blob.constData() + pos, qMin(chunkSize, blob.size() - pos));
+            _buffer += hex ? chunk.toHex() : chunk.toBase64();
+            if (_buffer.size() >= BufferSize)
+                flush();
+        }
+        _buffer += '"';
+        endDictionary();
+    }
+
+    void integer(qlonglong integer)
+    {
+        beginItem();
+        _buffer += QByteArray::number(integer);
+    }
+
+    void null()
+    {
+        beginItem();
+        _buffer += "null";
+    }
+
+    bool finish()
+    {
+        if (_indented)
+            _buffer += '\n';
+        flush();
+        return _ok;
+    }
+
+private:
+    static const int BufferSize = 64 * 1024;
+
+    void beginContainer(char c)
+    {
+        beginItem();
+        _buffer += c;
+        if (_indented)
+            _buffer += '\n';
+        _level++;
+        _first = true;
+    }
+
+    void endContainer(char c)
+    {
+        _level--;
+        if (_indented) {
+            if (!_first)
+                _buffer += '\n';
+            indent();
+        }
+        _buffer += c;
+        _first = false;
+    }
+
+    void beginItem()
+    {
+        if (_afterKey) {
+            _afterKey = false;
+            return;
+        }
+
+        if (_buffer.size() >= BufferSize)
+            flush();
+
+        if (!_first)
+            _buffer += _indented ? ",\n" : ",";
+        _first = false;
+
+        if (_indented)
+            indent();
+    }
+
+    void indent()
+    {
+        for (int i = 0; i < _level; i++)
+            _buffer += "    ";
+    }
+
+    void writeString(const QByteArray &string)
+    {
+        _buffer += '"';
+        writeStringContent(string.constData(), string.size());
+        _buffer += '"';
+    }
+
+    // Non printable symbols and '%' are written as %HH like Bencode::fromRawString() does
+    void writeStringContent(const char *p, int size)
+    {
+        static const int ChunkSize = 16 * 1024;
+
+        while (size > 0) {
+            int chunk = qMin(size, ChunkSize);
+            int oldSize = _buffer.size();
+            // Upper bound. '"' and '\\' take one extra byte, %HH takes two.
+            _buffer.resize(oldSize + chunk + 2 * escapedCount<true>(p, chunk));
+            char *out = _buffer.data() + oldSize;
+
+            int i = 0;
+            while (i < chunk) {
+                int plain = plainLength<true>(p + i, chunk - i);
+                memcpy(out, p + i, plain);
+                out += plain;
+                i += plain;
+                if (i == chunk)
+                    break;
+
+                uchar c = static_cast<uchar>(p[i++]);
+                if (c == '"' || c == '\\') {
+                    *out++ = '\\';
+                    *out++ = static_cast<char>(c);
+                }
+                else {
+                    *out++ = '%';
+                    *out++ = HexDigits[c >> 4];
+                    *out++ = HexDigits[c & 0xf];
+                }
+            }
+            _buffer.resize(static_cast<int>(out - _buffer.constData()));
+
+            p += chunk;
+            size -= chunk;
+            if (_buffer.size() >= BufferSize)
+                flush();
+        }
+    }
+
+    void flush()
+    {
+        // Part writer keeps everything in memory
+        if (!_device)
+            return;
+
+        if (_ok && !_buffer.isEmpty() && _device->write(_buffer) != _buffer.size())
+            _ok = false;
+        _buffer.resize(0);
+    }
+
+    QIODevice *_device;
+    bool _indented;
+    Bencode::BlobEncoding _blobEncoding;
+    QByteArray _buffer;
+    int _level;
+    bool _first;
+    bool _afterKey;
+    bool _ok;
+};
+
+namespace {
+
+// Converts raw bencode to JSON on the fly without building items
+class RawJsonConverter
+{
+public:
+    RawJsonConverter(const QByteArray &raw, JsonWriter &writer)
+        : _raw(raw)
+        , _writer(writer)
+        , _pos(0)
+    {
+    }
+
+    bool convert()
+    {
+        return !_raw.isEmpty() && convertItem(false) && _pos == _raw.size();
+    }
+
+private:
+    bool convertItem(bool hex)
+    {
+        if (_pos >= _raw.size())
+            return false;
+
+        switch (_raw.at(_pos)) {
+        case 'i': {
+            int end = _raw.indexOf('e', _pos + 1);
+            if (end == -1)
+                return false;
+
+            bool ok;
+            qlonglong integer = QByteArray::fromRawData(_raw.constData() + _pos + 1, end - _pos - 1).toLongLong(&ok);
+            if (!ok)
+                return false;
+
+            _writer.integer(integer);
+            _pos = end + 1;
+            return true; }
+
+        case 'l':
+            _pos++;
+            _writer.beginList();
+            while (_pos < _raw.size() && _raw.at(_pos) != 'e') {
+                if (!convertItem(false))
+                    return false;
+            }
+            _writer.endList();
+            return _pos++ < _raw.size();
+
+        case 'd':
+            _pos++;
+            _writer.beginDictionary();
+            while (_pos < _raw.size() && _raw.at(_pos) != 'e') {
+                QByteArray key;
+                if (!readString(key))
+                    return false;
+                _writer.key(key);
+
+                if (!convertItem(KeyTable::isHex(key)))
+                    return false;
+            }
+            _writer.endDictionary();
+            return _pos++ < _raw.size();
+
+        default: {
+            QByteArray string;
+            if (!readString(string))
+                return false;
+
+            if (hex)
+                _writer.blob(string);
+            else
+                _writer.string(string);
+            return true; }
+        }
+    }
+
+    // Returned string refers to the raw data
+    bool readString(QByteArray &string)
+    {
+        int delimiter = _raw.indexOf(':', _pos);
+        if (delimiter <= _pos)
+            return false;
+
+        bool ok;
+        int size = QByteArray::fromRawData(_raw.constData() + _pos, delimiter - _pos).toInt(&ok);
+        if (!ok || size < 0 || size > _raw.size() - delimiter - 1)
+            return false;
+
+        string = QByteArray::fromRawData(_raw.constData() + delimiter + 1, size);
+        _pos = delimiter + 1 + size;
+        return true;
+    }
+
+    const QByteArray &_raw;
+    JsonWriter &_writer;
+    int _pos;
+};
+
+// Smaller containers are not worth to be parsed in parallel
+const int ParallelMinChildren = 1024;
+const int ParallelMinSize = 1024 * 1024;
+// Items per chunk of a wide container written to JSON in parallel
+const int JsonChunkItems = 256;
+
+// Wide containers are serialized on a thread pool
+inline bool isWide(int count)
+{
+    return count >= ParallelMinChildren && QThread::idealThreadCount() > 1;
+}
+
+// More chunks than threads to balance items of different size
+inline int parallelChunks(int count)
+{
+    return qMax(1, qMin(count, QThread::idealThreadCount() * 4));
+}
+
+// Calls function(from, to, chunk) for parallelChunks(count) ranges of [0, count)
+// on a thread pool and waits for all of them
+template<typename Function>
+void parallelFor(int count, const Function &function)
+{
+    const int chunkCount = parallelChunks(count);
+    QThreadPool pool;
+    pool.setMaxThreadCount(QThread::idealThreadCount());
+    for (int chunk = 0; chunk < chunkCount; ++chunk) {
+        int from = static_cast<int>(static_cast<qint64>(count) * chunk / chunkCount);
+        int to = static_cast<int>(static_cast<qint64>(count) * (chunk + 1) / chunkCount);
+        pool.start(makeTask([&function, from, to, chunk]() { function(from, to, chunk); }));
+    }
+    pool.waitForDone();
+}
+
+inline int decimalLength(qlonglong value)
+{
+    quint64 abs = value < 0 ? 0 - static_cast<quint64>(value) : static_cast<quint64>(value);
+    int length = value < 0 ? 2 : 1;
+    while (abs >= 10) {
+        abs /= 10;
+        length++;
+    }
+    return length;
+}
+
+inline char *writeDecimal(char *out, qlonglong value)
+{
+    quint64 abs = value < 0 ? 0 - static_cast<quint64>(value) : static_cast<quint64>(value);
+    char *end = out + decimalLength(value);
+    char *p = end;
+    do {
+        *--p = static_cast<char>('0' + abs % 10);
+        abs /= 10;
+    } while (abs);
+
+    if (value < 0)
+        *--p = '-';
+    return end;
+}
+
+// Size of <length>:<data>
+inline qint64 rawStringSize(int size)
+{
+    return decimalLength(size) + 1 + size;
+}
+
+inline char *writeRawString(char *out, const QByteArray &string)
+{
+    out = writeDecimal(out, string.size());
+    *out++ = ':';
+    memcpy(out, string.constData(), string.size());
+    return out + string.size();
+}
+
+} // namespace
+
 Bencode::Bencode(Type type, const QByteArray &key)
     : AbstractTreeNode(nullptr)
-    , _type(type)
-    , _integer(0)
-    , _string(QByteArray())
     , _key(key)
+    , _type(type)
     , _hex(false)
 {
+    initValue();
 }
 
 Bencode::Bencode(qlonglong integer, const QByteArray &key)
     : AbstractTreeNode(nullptr)
-    , _type(Integer)
-    , _integer(integer)
-    , _string(QByteArray())
     , _key(key)
+    , _integer(integer)
+    , _type(Integer)
     , _hex(false)
 {
 }
 
 Bencode::Bencode(const QByteArray &string, const QByteArray &key)
     : AbstractTreeNode(nullptr)
-    , _type(String)
-    , _integer(0)
-    , _string(string)
     , _key(key)
+    , _string(string)
+    , _type(String)
     , _hex(false)
 {
 }
 
+Bencode::~Bencode()
+{
+    // Children notify the parent. So delete them while it is alive.
+    QList<Bencode*> items = fetchedChildren();
+    qDeleteAll(items);
+    destroyValue();
+}
+
 void Bencode::setType(Type type)
 {
     if (type == _type)
         return;
 
+    // No need to fetch children which will be removed
+    if (isContainer())
+        _container->shared = SharedContent();
+
     qDeleteAll(children());
-    _integer = 0;
-    _string = QByteArray();
+    destroyValue();
     _type = type;
+    initValue();
+
+    // New container is not valid yet, so start from the parent
+    if (parent())
+        parent()->invalidateFingerprint();
+}
+
+void Bencode::initValue()
+{
+    switch (_type) {
+    case String:
+        new (&_string) QByteArray();
+        break;
+
+    case List:
+    case Dictionary:
+        _container = new Container;
+        break;
+
+    default:
+        _integer = 0;
+        break;
+    }
+}
+
+void Bencode::destroyValue()
+{
+    switch (_type) {
+    case String:
+        _string.~QByteArray();
+        break;
+
+    case List:
+    case Dictionary:
+        delete _container;
+        break;
+
+    default:
+        break;
+    }
+}
+
+void Bencode::setKey(const QByteArray &key)
+{
+    _key = key;
+
+    // Keys are part of the parent fingerprint
+    if (parent())
+        parent()->invalidateFingerprint();
 }
 
 Bencode *Bencode::checkAndCreate(Type type, int index)
@@ -116,6 +1387,12 @@ void Bencode::appendMapItem(Bencode *item)
     if (item->parent())
         item->parent()->removeChild(item);
 
+    // Parsed dictionaries are sorted already
+    if (!childCount() || child(childCount() - 1)->_key < item->_key) {
+        appendChild(item);
+        return;
+    }
+
     for (int i = 0; i < childCount(); i++) {
         if (item->_key < child(i)->_key) {
             insertChild(i, item);
@@ -151,10 +1428,28 @@ QVariant Bencode::toJson() const
     return toJson(this);
 }
 
-Bencode *Bencode::fromRaw(const QByteArray &raw)
+bool Bencode::toJson(QIODevice *device, JsonFormat format, BlobEncoding blobEncoding) const
+{
+    if (!isValid())
+        return false;
+
+    JsonWriter writer(device, format, blobEncoding);
+    toJson(this, writer, true);
+    return writer.finish();
+}
+
+bool Bencode::rawToJson(const QByteArray &raw, QIODevice *device, JsonFormat format, BlobEncoding blobEncoding)
+{
+    JsonWriter writer(device, format, blobEncoding);
+    RawJsonConverter converter(raw, writer);
+    return converter.convert() && writer.finish();
+}
+
+Bencode *Bencode::fromRaw(const QByteArray &raw, ParseMode mode)
 {
     int pos = 0;
-    Bencode *res = parseItem(raw, pos);
+    KeyTable keys;
+    Bencode *res = parseItem(raw, pos, keys, raw.size() < ParallelMinSize ? ParseMode::Serial : mode);
     return res;
 }
 
@@ -170,20 +1465,27 @@ Bencode *Bencode::fromJson(const QVariant &json)
     case QVariant::Map: {
         QVariantMap variantMap = json.toMap();
         res = new Bencode(Type::Dictionary);
-        QStringList keys = variantMap.keys();
+        QList<Bencode*> items;
+
+        for (auto it = variantMap.constBegin(); it != variantMap.constEnd(); ++it) {
+            Bencode *newItem = fromJson(it.value());
+            if (!newItem) {
+                qDeleteAll(items);
+                delete res;
+                return nullptr;
+            }
 
-        foreach (const QString &key, keys) {
-            Bencode *newItem = fromJson(variantMap.value(key));
-            newItem->_key = toRawString(key);
-            if (hexKeys.contains(QString(key)))
-                newItem->_hex = true;
+            bool hex;
+            newItem->_key = KeyTable::known(toRawString(it.key()), &hex);
+            newItem->_hex = hex;
 
-            int pos = 0;
-            while (pos < res->childCount() && newItem->_key > res->child(pos)->key()) {
-                pos++;
-            }
+            items << newItem;
+        }
 
-            res->insertChild(pos, newItem);
+        // Map is sorted by unicode keys but items must be sorted by raw keys
+        std::sort(items.begin(), items.end(), keyLessThan);
+        for (Bencode *item: items) {
+            res->appendChild(item);
         }
         break; }
 
@@ -204,83 +1506,277 @@ Bencode *Bencode::fromJson(const QVariant &json)
         break;
 
     default:
-#ifdef DEBUG
-        qDebug() << "wrong variant" << json.type();
-#endif
+#ifdef DEBUG
+        qDebug() << "wrong variant" << json.type();
+#endif
+        break;
+    }
+
+    return res;
+}
+
+Bencode *Bencode::fromJson(const QByteArray &json, QString *errorString, int *errorOffset)
+{
+    JsonReader reader(json);
+    Bencode *res = reader.read();
+
+    if (errorString)
+        *errorString = reader.errorString();
+
+    if (errorOffset)
+        *errorOffset = reader.errorOffset();
+
+    return res;
+}
+
+Bencode *Bencode::share(Bencode *bencode)
+{
+    Q_ASSERT(bencode);
+    Q_ASSERT(!bencode->parent());
+
+    QSharedPointer<Bencode> storage(bencode);
+    return shareItem(bencode, storage);
+}
+
+QString Bencode::typeToStr(Type type)
+{
+    switch (type) {
+    case List:        return QObject::tr("list");        break;
+    case Dictionary:  return QObject::tr("dictionary");  break;
+    case Integer:     return QObject::tr("integer");     break;
+    case String:      return QObject::tr("string");      break;
+    case Invalid:     return QObject::tr("invalid");     break;
+    }
+
+    return QString();
+}
+
+Bencode::Fingerprint Bencode::fingerprint() const
+{
+    // Only containers cache the fingerprint
+    if (isContainer() && _container->fingerprintValid)
+        return _container->fingerprint;
+
+    if (sharedItem()) {
+        _container->fingerprint = sharedItem()->fingerprint();
+        _container->fingerprintValid = true;
+        return _container->fingerprint;
+    }
+
+    Fingerprint hash;
+    hash.low = FingerprintSeed;
+    hash.high = FingerprintSeed2;
+    mixFingerprint(hash, static_cast<quint64>(_type));
+    switch (_type) {
+    case Type::Integer:
+        mixFingerprint(hash, static_cast<quint64>(_integer));
+        break;
+
+    case Type::String:
+        hashBytes(hash, _string);
+        break;
+
+    case Type::Dictionary:
+        for (const Bencode *item: items()) {
+            hashBytes(hash, item->_key);
+            mixFingerprint(hash, item->fingerprint());
+        }
+        break;
+
+    case Type::List:
+        for (const Bencode *item: items()) {
+            mixFingerprint(hash, item->fingerprint());
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    if (isContainer()) {
+        _container->fingerprint = hash;
+        _container->fingerprintValid = true;
+    }
+    return hash;
+}
+
+bool Bencode::compare(const Bencode *other) const
+{
+    if (!other)
+        return false;
+
+    if (_type != other->_type)
+        return false;
+
+    if (parent() && static_cast<Bencode*>(parent())->_type == Type::Dictionary && other->parent() && _key != other->_key)
+        return false;
+
+    // Both items are copies of the same shared item
+    if (content() == other->content())
+        return true;
+
+    return compareContent(other);
+}
+
+bool Bencode::compareContent(const Bencode *other) const
+{
+    if (_type != other->_type)
+        return false;
+
+    if (content() == other->content())
+        return true;
+
+    // Values of leaves are cheaper to compare than to hash
+    switch (_type) {
+    case Type::Integer:
+        return _integer == other->_integer;
+
+    case Type::String:
+        return _string == other->_string;
+
+    case Type::Dictionary:
+    case Type::List: {
+        // Cached fingerprints reject most of different subtrees at once.
+        // Equal ones are walked to rule out a collision.
+        if (fingerprint() != other->fingerprint())
+            return false;
+
+        const QList<Bencode*> &list = items();
+        const QList<Bencode*> &otherList = other->items();
+        if (list.size() != otherList.size())
+            return false;
+
+        for (int i = 0; i < list.size(); i++) {
+            if (_type == Type::Dictionary && list.at(i)->_key != otherList.at(i)->_key)
+                return false;
+
+            if (!list.at(i)->compareContent(otherList.at(i)))
+                return false;
+        }
+        return true; }
+
+    default:
+        return true;
+    }
+}
+
+qint64 Bencode::byteSize() const
+{
+    qint64 res = sizeof(Bencode) + _key.size();
+    if (isString()) {
+        res += _string.size();
+    }
+    else if (isContainer()) {
+        res += sizeof(Container) + items().size() * sizeof(Bencode*);
+        for (const Bencode *item: items()) {
+            res += item->byteSize();
+        }
+    }
+    return res;
+}
+
+Bencode *Bencode::clone() const
+{
+    Bencode *newItem = new Bencode(_type, _key);
+    newItem->_hex = _hex;
+
+    switch (_type) {
+    case Integer:
+        newItem->_integer = _integer;
+        break;
+
+    case String:
+        newItem->_string = _string;
+        break;
+
+    case List:
+    case Dictionary:
+        if (sharedItem()) {
+            newItem->_container->shared = _container->shared;
+        }
+        else {
+            for (Bencode *child: children()) {
+                newItem->appendChild(child->clone());
+            }
+        }
+        newItem->_container->fingerprint = _container->fingerprint;
+        newItem->_container->fingerprintValid = _container->fingerprintValid;
+        break;
+
+    default:
         break;
     }
 
-    return res;
+    return newItem;
 }
 
-QString Bencode::typeToStr(Type type)
+void Bencode::childrenChanged()
 {
-    switch (type) {
-    case List:        return QObject::tr("list");        break;
-    case Dictionary:  return QObject::tr("dictionary");  break;
-    case Integer:     return QObject::tr("integer");     break;
-    case String:      return QObject::tr("string");      break;
-    case Invalid:     return QObject::tr("invalid");     break;
-    }
-
-    return QString();
+    invalidateFingerprint();
 }
 
-bool Bencode::compare(const Bencode *other) const
+void Bencode::fetchChildren() const
 {
-    if (!other)
-        return false;
+    if (!sharedItem())
+        return;
 
-    if (_type != other->_type)
-        return false;
+    Bencode *self = const_cast<Bencode*>(this);
+    const SharedContent shared = _container->shared;
+    self->_container->shared = SharedContent();
 
-    if (parent() && static_cast<Bencode*>(parent())->_type == Type::Dictionary && other->parent() && _key != other->_key)
-        return false;
+    // Content is not changed. Keep fingerprint and do not touch parents.
+    bool fingerprintValid = _container->fingerprintValid;
+    self->_container->fingerprintValid = false;
 
-    switch (_type) {
-    case Type::String:
-        if (_string != other->_string)
-            return false;
-        break;
+    for (const Bencode *item: shared.item->fetchedChildren()) {
+        self->appendChild(shareItem(item, shared.storage));
+    }
 
-    case Type::Integer:
-        if (_integer != other->_integer)
-            return false;
+    self->_container->fingerprintValid = fingerprintValid;
+}
+
+Bencode *Bencode::shareItem(const Bencode *item, const QSharedPointer<Bencode> &storage)
+{
+    Bencode *res = new Bencode(item->_type, item->_key);
+    res->_hex = item->_hex;
+
+    switch (item->_type) {
+    case Integer:
+        res->_integer = item->_integer;
         break;
 
-    case Type::Dictionary:
-    case Type::List:
-        if (childCount() != other->childCount())
-            return false;
+    case String:
+        res->_string = item->_string;
+        break;
 
-        for (int i = 0; i < childCount(); i++) {
-            bool res = child(i)->compare(other->child(i));
-            if (!res) {
-                return false;
-            }
+    case List:
+    case Dictionary:
+        // Item in the storage can be a not fetched copy of another storage
+        if (item->sharedItem()) {
+            res->_container->shared = item->_container->shared;
         }
+        else if (!item->fetchedChildren().isEmpty()) {
+            res->_container->shared.item = item;
+            res->_container->shared.storage = storage;
+        }
+        res->_container->fingerprint = item->_container->fingerprint;
+        res->_container->fingerprintValid = item->_container->fingerprintValid;
         break;
 
     default:
         break;
     }
 
-    return true;
+    return res;
 }
 
-Bencode *Bencode::clone() const
+void Bencode::invalidateFingerprint()
 {
-    Bencode *newItem = new Bencode;
-    newItem->_type = _type;
-    newItem->_integer = _integer;
-    newItem->_string = _string;
-    newItem->_key = _key;
-    newItem->_hex = _hex;
-
-    for (Bencode *child: children()) {
-        newItem->appendChild(child->clone());
+    // If item is already invalidated then all parents are invalidated too.
+    // Parents are always containers.
+    for (Bencode *item = isContainer() ? this : parent(); item && item->_container->fingerprintValid; item = item->parent()) {
+        item->_container->fingerprintValid = false;
     }
-    return newItem;
 }
 
 QString Bencode::toString() const
@@ -301,12 +1797,20 @@ QString Bencode::toString() const
     return res;
 }
 
-Bencode *Bencode::parseItem(const QByteArray &raw, int &pos)
+Bencode *Bencode::parseItem(const QByteArray &raw, int &pos, KeyTable &keys, ParseMode mode)
 {
     // it is ok to parse empty bencode
     if (pos == 0 && raw.isEmpty())
         return nullptr;
 
+    // Raw can be a not null terminated file mapping
+    if (pos >= raw.size()) {
+#ifdef DEBUG
+        qDebug() << "unexpected end of data";
+#endif
+        return new Bencode();
+    }
+
     // Integer
     if (raw[pos] == 'i') {
         return parseInteger(raw, pos);
@@ -317,11 +1821,11 @@ Bencode *Bencode::parseItem(const QByteArray &raw, int &pos)
     }
     // List
     else if (raw[pos] == 'l') {
-        return parseList(raw, pos);
+        return parseList(raw, pos, keys, mode);
     }
     // Dictionary
     else if (raw[pos] == 'd') {
-        return parseDictionary(raw, pos);
+        return parseDictionary(raw, pos, keys, mode);
     }
     else {
 #ifdef DEBUG
@@ -367,18 +1871,38 @@ Bencode *Bencode::parseInteger(const QByteArray &raw, int &pos)
     return res;
 }
 
+bool Bencode::parseStringData(const QByteArray &raw, int &pos, int &begin, int &size)
+{
+    int delimiter = raw.indexOf(':', pos);
+    bool ok = false;
+    size = delimiter == -1 ? -1 : QByteArray::fromRawData(raw.constData() + pos, delimiter - pos).toInt(&ok);
+    if (!ok || size < 0 || size > raw.size() - delimiter - 1) {
+        pos = raw.size();
+        return false;
+    }
+
+    begin = delimiter + 1;
+    pos = begin + size;
+    return true;
+}
+
 Bencode *Bencode::parseString(const QByteArray &raw, int &pos)
 {
 #ifdef DEBUG
     int basePos = pos;
 #endif
 
-    int delimiter = raw.indexOf(':', pos);
-    int size = QString::fromUtf8(raw.mid(pos, delimiter - pos)).toInt();
+    int begin;
+    int size;
+    if (!parseStringData(raw, pos, begin, size)) {
+#ifdef DEBUG
+        qDebug() << "byte array parsing error. pos" << basePos;
+#endif
+        return new Bencode;
+    }
 
-    delimiter++;
-    Bencode *res = new Bencode(raw.mid(delimiter, size));
-    pos = delimiter + size;
+    // Deep copy. Raw can refer to a file mapping which is closed after parsing.
+    Bencode *res = new Bencode(QByteArray(raw.constData() + begin, size));
 
 #ifdef DEBUG
     qDebug() << "byte array parsed" << fromRawString(res->_string).mid(0, 100) << "pos" << basePos << "=>" << pos;
@@ -387,8 +1911,11 @@ Bencode *Bencode::parseString(const QByteArray &raw, int &pos)
     return res;
 }
 
-Bencode *Bencode::parseList(const QByteArray &raw, int &pos)
+Bencode *Bencode::parseList(const QByteArray &raw, int &pos, KeyTable &keys, ParseMode mode)
 {
+    if (mode == ParseMode::Parallel)
+        return parseParallel(raw, pos, keys);
+
 #ifdef DEBUG
     int basePos = pos;
     int i = 0;
@@ -396,12 +1923,12 @@ Bencode *Bencode::parseList(const QByteArray &raw, int &pos)
     pos++;
     Bencode *res = new Bencode(Type::List);
 
-    while(raw[pos] != 'e') {
+    while(pos < raw.size() && raw[pos] != 'e') {
 #ifdef DEBUG
         qDebug() << "list parsing" << i++ << "item";
 #endif
 
-        Bencode *item = parseItem(raw, pos);
+        Bencode *item = parseItem(raw, pos, keys);
         Q_ASSERT(item);
 
         // some error happens
@@ -412,6 +1939,11 @@ Bencode *Bencode::parseList(const QByteArray &raw, int &pos)
         }
         res->appendChild(item);
     }
+
+    if (pos >= raw.size()) {
+        delete res;
+        return new Bencode;
+    }
     pos++;
 #ifdef DEBUG
     qDebug() << "list parsed" << res->children().size() << "pos" << basePos << "=>" << pos;
@@ -419,8 +1951,11 @@ Bencode *Bencode::parseList(const QByteArray &raw, int &pos)
     return res;
 }
 
-Bencode *Bencode::parseDictionary(const QByteArray &raw, int &pos)
+Bencode *Bencode::parseDictionary(const QByteArray &raw, int &pos, KeyTable &keys, ParseMode mode)
 {
+    if (mode == ParseMode::Parallel)
+        return parseParallel(raw, pos, keys);
+
 #ifdef DEBUG
     int basePos = pos;
 #endif
@@ -429,19 +1964,25 @@ Bencode *Bencode::parseDictionary(const QByteArray &raw, int &pos)
     Bencode *res = new Bencode(Type::Dictionary);
 
 #ifdef DEBUG
-    QStringList keys;
+    QStringList parsedKeys;
 #endif
 
-    while(raw[pos] != 'e') {
-        Bencode *keyItem = parseString(raw, pos);
-        QByteArray key = keyItem->_string;
-        delete keyItem;
+    while(pos < raw.size() && raw[pos] != 'e') {
+        int keyBegin;
+        int keySize;
+        if (!parseStringData(raw, pos, keyBegin, keySize)) {
+            delete res;
+            return new Bencode();
+        }
+
+        bool hex;
+        QByteArray key = keys.intern(raw.constData() + keyBegin, keySize, &hex);
 
 #ifdef DEBUG
-        keys << fromRawString(key);
-        qDebug() << "map parsing" << keys.last() << "item";
+        parsedKeys << fromRawString(key);
+        qDebug() << "map parsing" << parsedKeys.last() << "item";
 #endif
-        Bencode *value = parseItem(raw, pos);
+        Bencode *value = parseItem(raw, pos, keys);
         Q_ASSERT(value);
 
         // some error happens
@@ -452,112 +1993,476 @@ Bencode *Bencode::parseDictionary(const QByteArray &raw, int &pos)
         }
 
         value->_key = key;
-        if (hexKeys.contains(QString::fromUtf8(key)))
-            value->_hex = true;
+        value->_hex = hex;
 
         res->appendMapItem(value);
     }
+
+    if (pos >= raw.size()) {
+        delete res;
+        return new Bencode();
+    }
     pos++;
 #ifdef DEBUG
-    qDebug() << "map parsed" << res->children().size() << keys << "pos" << basePos << "=>" << pos;
+    qDebug() << "map parsed" << res->children().size() << parsedKeys << "pos" << basePos << "=>" << pos;
 #endif
     return res;
 }
 
-QString Bencode::fromRawString(const QByteArray &raw)
+Bencode *Bencode::parseParallel(const QByteArray &raw, int &pos, KeyTable &keys)
 {
-    QString res;
-    for (int i = 0; i < raw.size(); ++i) {
-        QChar c = QLatin1Char(raw[i]);
-        // All normal ASCII symbols except '%'
-        if (c >= QLatin1Char(' ') && c <= QLatin1Char('~') && c != QLatin1Char('%')) {
-            res += QLatin1Char(raw[i]);
+    // Child position in the raw data
+    struct Span
+    {
+        int keyBegin;
+        int keySize;
+        int begin;
+        int end;
+    };
+
+    const int basePos = pos;
+    const bool dictionary = raw.at(pos) == 'd';
+
+    // Fast skip-scan for child boundaries. Nothing is allocated.
+    QVector<Span> spans;
+    int end = pos + 1;
+    while (end < raw.size() && raw.at(end) != 'e') {
+        Span span = {0, 0, 0, 0};
+        if (dictionary && !parseStringData(raw, end, span.keyBegin, span.keySize))
+            break;
+
+        span.begin = end;
+        if (!skipItem(raw, end))
+            break;
+
+        span.end = end;
+        spans.append(span);
+    }
+
+    if (end >= raw.size() || raw.at(end) != 'e') {
+#ifdef DEBUG
+        qDebug() << "container parsing error. pos" << basePos;
+#endif
+        pos = raw.size();
+        return new Bencode();
+    }
+
+    const int count = spans.size();
+    const Span *spanData = spans.constData();
+    QVector<Bencode*> items(count, nullptr);
+    Bencode **itemData = items.data();
+
+    // Parses children in [from, to). Large children on this thread are
+    // scanned again so nested containers like info/files are parallel too.
+    auto parseRange = [&raw, dictionary, spanData, itemData](int from, int to, KeyTable &rangeKeys, bool nested) -> bool {
+        for (int i = from; i < to; ++i) {
+            const Span &span = spanData[i];
+            int itemPos = span.begin;
+            ParseMode mode = nested && span.end - span.begin >= ParallelMinSize ? ParseMode::Parallel : ParseMode::Serial;
+            Bencode *item = parseItem(raw, itemPos, rangeKeys, mode);
+            if (!item || !item->isValid() || itemPos != span.end) { // -V560 PVS-Studio
+                delete item;
+                return false;
+            }
+
+            if (dictionary) {
+                bool hex;
+                item->_key = rangeKeys.intern(raw.constData() + span.keyBegin, span.keySize, &hex);
+                item->_hex = hex;
+            }
+            itemData[i] = item;
         }
-        else {
-            res += QLatin1Char('%');
-            res += QString::fromUtf8(raw.mid(i, 1).toHex());
+        return true;
+    };
+
+    bool ok = true;
+    const int threads = QThread::idealThreadCount();
+    if (count < ParallelMinChildren || end - basePos < ParallelMinSize || threads < 2) {
+        ok = parseRange(0, count, keys, true);
+    }
+    else {
+        // Chunks of about equal size. More chunks than threads
+        // to balance entries of different size.
+        const int chunkCount = qMin(count, threads * 4);
+        const qint64 chunkSize = (static_cast<qint64>(end) - basePos) / chunkCount + 1;
+        QVector<char> results(chunkCount, 0);
+        char *resultData = results.data();
+
+        QThreadPool pool;
+        pool.setMaxThreadCount(threads);
+        int started = 0;
+        int from = 0;
+        for (int chunk = 0; chunk < chunkCount && from < count; ++chunk) {
+            int to = from + 1;
+            while (to < count && spanData[to].end - spanData[from].begin < chunkSize)
+                ++to;
+
+            if (chunk == chunkCount - 1)
+                to = count;
+
+            pool.start(makeTask([parseRange, from, to, resultData, chunk]() {
+                // Keys are interned per chunk. Tables are not thread safe.
+                KeyTable chunkKeys;
+                resultData[chunk] = parseRange(from, to, chunkKeys, false);
+            }));
+            from = to;
+            started++;
         }
+        pool.waitForDone();
+
+        for (int chunk = 0; chunk < started; ++chunk) {
+            if (!resultData[chunk])
+                ok = false;
+        }
+
+#ifdef DEBUG
+        qDebug() << "parallel parsing" << count << "items in" << chunkCount << "chunks";
+#endif
+    }
+
+    if (!ok) {
+        qDeleteAll(items);
+        pos = raw.size();
+        return new Bencode();
     }
 
+    // Stitch children in the original order
+    Bencode *res = new Bencode(dictionary ? Type::Dictionary : Type::List);
+    for (Bencode *item: items) {
+        if (dictionary)
+            res->appendMapItem(item);
+        else
+            res->appendChild(item);
+    }
+
+    pos = end + 1;
+#ifdef DEBUG
+    qDebug() << "container parsed" << count << "pos" << basePos << "=>" << pos;
+#endif
     return res;
 }
 
-QByteArray Bencode::toRawString(const QString &string)
+bool Bencode::dictionarySpans(const QByteArray &raw, QList<RawSpan> &spans, int pos, int *end)
 {
-    QByteArray ba = string.toLatin1();
-    QByteArray res;
-    for (int i = 0; i < ba.size(); ++i) {
-        QChar c = string[i];
-        if (c != QLatin1Char('%')) {
-            res += ba[i];
+    spans.clear();
+    if (pos >= raw.size() || raw.at(pos) != 'd')
+        return false;
+
+    pos++;
+    while (pos < raw.size() && raw.at(pos) != 'e') {
+        RawSpan span;
+        span.keyBegin = pos;
+
+        int begin;
+        int size;
+        if (!parseStringData(raw, pos, begin, size))
+            return false;
+
+        span.key = raw.mid(begin, size);
+        span.begin = pos;
+        if (!skipItem(raw, pos))
+            return false;
+
+        span.end = pos;
+        spans << span;
+    }
+
+    if (pos >= raw.size())
+        return false;
+
+    if (end)
+        *end = pos + 1;
+    return true;
+}
+
+const Bencode::RawSpan *Bencode::findSpan(const QList<RawSpan> &spans, const QByteArray &key)
+{
+    for (const RawSpan &span: spans) {
+        if (span.key == key)
+            return &span;
+    }
+    return nullptr;
+}
+
+bool Bencode::skipItem(const QByteArray &raw, int &pos)
+{
+    if (pos >= raw.size())
+        return false;
+
+    switch (raw.at(pos)) {
+    case 'i': {
+        int end = raw.indexOf('e', pos + 1);
+        if (end == -1)
+            return false;
+
+        pos = end + 1;
+        return true; }
+
+    case 'l':
+    case 'd': {
+        const bool dictionary = raw.at(pos) == 'd';
+        pos++;
+        while (pos < raw.size() && raw.at(pos) != 'e') {
+            int begin;
+            int size;
+            if (dictionary && !parseStringData(raw, pos, begin, size))
+                return false;
+
+            if (!skipItem(raw, pos))
+                return false;
         }
-        else {
-            res += QByteArray::fromHex(ba.mid(i + 1, 2));
-            i += 2;
+        return pos++ < raw.size(); }
+
+    default: {
+        if (raw.at(pos) < '0' || raw.at(pos) > '9')
+            return false;
+
+        int begin;
+        int size;
+        return parseStringData(raw, pos, begin, size); }
+    }
+}
+
+Bencode::ScanResult Bencode::scanItem(const QByteArray &raw, int pos, int *end)
+{
+    ScanResult res = scanValue(raw, pos, 0);
+    if (res == ScanResult::Complete && end)
+        *end = pos;
+    return res;
+}
+
+Bencode::ScanResult Bencode::scanValue(const QByteArray &raw, int &pos, int depth)
+{
+    // Deeper nesting is not expected in real files and would exhaust the stack
+    const int MaxDepth = 1024;
+
+    const char *data = raw.constData();
+    const int size = raw.size();
+    if (pos >= size)
+        return ScanResult::Incomplete;
+
+    switch (data[pos]) {
+    case 'i': {
+        pos++;
+        if (pos < size && data[pos] == '-')
+            pos++;
+
+        const int digits = pos;
+        while (pos < size && data[pos] >= '0' && data[pos] <= '9')
+            pos++;
+
+        if (pos >= size)
+            return ScanResult::Incomplete;
+
+        if (data[pos] != 'e' || pos == digits)
+            return ScanResult::Invalid;
+
+        pos++;
+        return ScanResult::Complete; }
+
+    case 'l':
+    case 'd': {
+        if (depth >= MaxDepth)
+            return ScanResult::Invalid;
+
+        const bool dictionary = data[pos] == 'd';
+        pos++;
+        for (;;) {
+            if (pos >= size)
+                return ScanResult::Incomplete;
+
+            if (data[pos] == 'e')
+                break;
+
+            // Keys are strings
+            if (dictionary && (data[pos] < '0' || data[pos] > '9'))
+                return ScanResult::Invalid;
+
+            ScanResult res = dictionary ? scanValue(raw, pos, depth + 1) : ScanResult::Complete;
+            if (res == ScanResult::Complete)
+                res = scanValue(raw, pos, depth + 1);
+            if (res != ScanResult::Complete)
+                return res;
+        }
+        pos++;
+        return ScanResult::Complete; }
+
+    default: {
+        if (data[pos] < '0' || data[pos] > '9')
+            return ScanResult::Invalid;
+
+        qint64 length = 0;
+        while (pos < size && data[pos] >= '0' && data[pos] <= '9') {
+            length = length * 10 + (data[pos] - '0');
+            if (length > std::numeric_limits<int>::max())
+                return ScanResult::Invalid;
+            pos++;
+        }
+
+        if (pos >= size)
+            return ScanResult::Incomplete;
+
+        if (data[pos] != ':')
+            return ScanResult::Invalid;
+
+        pos++;
+        if (length > size - pos) {
+            pos = size;
+            return ScanResult::Incomplete;
         }
+
+        pos += static_cast<int>(length);
+        return ScanResult::Complete; }
+    }
+}
+
+QString Bencode::fromRawString(const QByteArray &raw)
+{
+    const char *p = raw.constData();
+    int size = raw.size();
+
+    // All normal ASCII symbols except '%' are kept. Others become %HH.
+    QString res(size + 2 * escapedCount<false>(p, size), Qt::Uninitialized);
+    ushort *out = reinterpret_cast<ushort*>(res.data());
+
+    int i = 0;
+    while (i < size) {
+        int plain = plainLength<false>(p + i, size - i);
+        widen(p + i, plain, out);
+        out += plain;
+        i += plain;
+        if (i == size)
+            break;
+
+        uchar c = static_cast<uchar>(p[i++]);
+        *out++ = '%';
+        *out++ = static_cast<uchar>(HexDigits[c >> 4]);
+        *out++ = static_cast<uchar>(HexDigits[c & 0xf]);
     }
 
     return res;
 }
 
+QByteArray Bencode::toRawString(const QString &string)
+{
+    // Decoded string is never longer. So decode in place.
+    QByteArray res = string.toLatin1();
+    percentDecode(res);
+    return res;
+}
+
 QByteArray Bencode::toRaw(const Bencode *bencode)
 {
+    // Exact size is known up front. So parts written in parallel
+    // go straight into their final positions.
+    qint64 size = rawSize(bencode, true);
+    if (size > std::numeric_limits<int>::max())
+        return QByteArray();
+
     QByteArray res;
-    switch (bencode->_type) {
-    case Integer:
-        res += 'i';
-        res += QString::number(bencode->_integer).toLatin1();
-        res += 'e';
-#ifdef DEBUG
-        qDebug() << "encode number" << bencode->_integer;
-#endif
-        break;
+    res.resize(static_cast<int>(size));
+    char *end = writeRaw(bencode, res.data(), true);
+    Q_ASSERT(end == res.constData() + res.size());
+    Q_UNUSED(end);
 
-    case String: {
-        QByteArray ba = bencode->_string;
-        res += QString::number(ba.size()).toLatin1();
-        res += ':';
-        res += ba;
 #ifdef DEBUG
-        qDebug() << "encode byte array size" << ba.size() << fromRawString(ba).mid(0, 100);
+    qDebug() << "encoded size" << res.size();
 #endif
-        break; }
+    return res;
+}
 
-    case List: {
-        res += 'l';
-        QList<Bencode*> list = bencode->children();
-        for (int i = 0; i < list.size(); ++i) {
-#ifdef DEBUG
-            qDebug() << "encoding" << i << "item";
-#endif
-            res += toRaw(list.at(i));
+qint64 Bencode::rawSize(const Bencode *bencode, bool parallel)
+{
+    switch (bencode->_type) {
+    case Integer:
+        return decimalLength(bencode->_integer) + 2;
+
+    case String:
+        return rawStringSize(bencode->_string.size());
+
+    case List:
+    case Dictionary: {
+        const bool dictionary = bencode->_type == Dictionary;
+        const QList<Bencode*> &list = bencode->items();
+        qint64 size = 2;
+        if (parallel && isWide(list.size())) {
+            QVector<qint64> sizes(list.size(), 0);
+            qint64 *sizeData = sizes.data();
+            parallelFor(list.size(), [&list, dictionary, sizeData](int from, int to, int) {
+                for (int i = from; i < to; ++i) {
+                    sizeData[i] = (dictionary ? rawStringSize(list.at(i)->_key.size()) : 0) + rawSize(list.at(i), false);
+                }
+            });
+
+            for (int i = 0; i < sizes.size(); ++i) {
+                size += sizeData[i];
+            }
         }
-#ifdef DEBUG
-        qDebug() << "encode list size" << list.size();
-#endif
-        res += 'e';
-        break; }
+        else {
+            for (const Bencode *item: list) {
+                size += (dictionary ? rawStringSize(item->_key.size()) : 0) + rawSize(item, parallel);
+            }
+        }
+        return size; }
+
+    default:
+        return 0;
+    }
+}
+
+char *Bencode::writeRaw(const Bencode *bencode, char *out, bool parallel)
+{
+    switch (bencode->_type) {
+    case Integer:
+        *out++ = 'i';
+        out = writeDecimal(out, bencode->_integer);
+        *out++ = 'e';
+        break;
+
+    case String:
+        out = writeRawString(out, bencode->_string);
+        break;
 
+    case List:
     case Dictionary: {
-        res += 'd';
-        QList<Bencode*> map = bencode->children();
-        QStringList fromRawKeys;
-        for (int i = 0; i < map.size(); ++i) {
-            QByteArray key = map.at(i)->_key;
-            fromRawKeys << fromRawString(key);
-#ifdef DEBUG
-            qDebug() << "encode" << fromRawString(key) << "item";
-#endif
-            res += QString::number(key.size()).toLatin1();
-            res += ':';
-            res += key;
+        const bool dictionary = bencode->_type == Dictionary;
+        const QList<Bencode*> &list = bencode->items();
+        *out++ = dictionary ? 'd' : 'l';
+
+        if (parallel && isWide(list.size())) {
+            // Offsets of items from their sizes
+            QVector<qint64> offsets(list.size() + 1, 0);
+            qint64 *offsetData = offsets.data();
+            parallelFor(list.size(), [&list, dictionary, offsetData](int from, int to, int) {
+                for (int i = from; i < to; ++i) {
+                    offsetData[i + 1] = (dictionary ? rawStringSize(list.at(i)->_key.size()) : 0) + rawSize(list.at(i), false);
+                }
+            });
+
+            for (int i = 0; i < list.size(); ++i) {
+                offsetData[i + 1] += offsetData[i];
+            }
 
-            res += toRaw(map.at(i));
+            parallelFor(list.size(), [&list, dictionary, offsetData, out](int from, int to, int) {
+                char *itemOut = out + offsetData[from];
+                for (int i = from; i < to; ++i) {
+                    if (dictionary)
+                        itemOut = writeRawString(itemOut, list.at(i)->_key);
+                    itemOut = writeRaw(list.at(i), itemOut, false);
+                }
+                Q_ASSERT(itemOut == out + offsetData[to]);
+            });
+            out += offsetData[list.size()];
         }
-        res += 'e';
-#ifdef DEBUG
-        qDebug() << "encode map" << fromRawKeys;
-#endif
+        else {
+            for (const Bencode *item: list) {
+                if (dictionary)
+                    out = writeRawString(out, item->_key);
+                out = writeRaw(item, out, parallel);
+            }
+        }
+
+        *out++ = 'e';
         break; }
 
     default:
@@ -565,9 +2470,8 @@ QByteArray Bencode::toRaw(const Bencode *bencode)
         qDebug() << "wrong type" << bencode->_type;
 #endif
         break;
-
     }
-    return res;
+    return out;
 }
 
 QVariant Bencode::toJson(const Bencode *bencode)
@@ -581,7 +2485,7 @@ QVariant Bencode::toJson(const Bencode *bencode)
 
     case Dictionary: {
         QVariantMap map;
-        for (const auto *item: bencode->children()) {
+        for (const auto *item: bencode->items()) {
             map.insert(fromRawString(static_cast<const Bencode*>(item)->_key), toJson(static_cast<const Bencode*>(item)));
         }
         res = map;
@@ -589,7 +2493,7 @@ QVariant Bencode::toJson(const Bencode *bencode)
 
     case List: {
         QVariantList list;
-        for (const auto *item: bencode->children()) {
+        for (const auto *item: bencode->items()) {
             list << toJson(static_cast<const Bencode*>(item));
         }
         res = list;
@@ -608,3 +2512,100 @@ QVariant Bencode::toJson(const Bencode *bencode)
 
     return res;
 }
+
+void Bencode::toJson(const Bencode *bencode, JsonWriter &writer, bool parallel)
+{
+    switch (bencode->_type) {
+    case String:
+        if (bencode->_hex)
+            writer.blob(bencode->_string);
+        else
+            writer.string(bencode->_string);
+        break;
+
+    case Dictionary:
+    case List: {
+        const bool dictionary = bencode->_type == Dictionary;
+        const QList<Bencode*> &list = bencode->items();
+        if (dictionary)
+            writer.beginDictionary();
+        else
+            writer.beginList();
+
+        if (parallel && isWide(list.size())) {
+            // Every chunk of items is written to its own buffer. Only a window
+            // of chunks is in flight and finished ones are written in order,
+            // so memory doesn't grow with the container.
+            const int count = list.size();
+            const int threads = QThread::idealThreadCount();
+            const int chunkItems = qBound(1, count / (threads * 4), JsonChunkItems);
+            const int chunkCount = (count + chunkItems - 1) / chunkItems;
+            const int window = qMin(chunkCount, threads * 2);
+
+            QVector<QByteArray> parts(window);
+            QByteArray *partData = parts.data();
+            QScopedArrayPointer<QSemaphore> done(new QSemaphore[window]);
+            QSemaphore *doneData = done.data();
+            // Tasks copy settings from it while the writer is busy
+            const JsonWriter container(writer, false);
+
+            QThreadPool pool;
+            pool.setMaxThreadCount(threads);
+            auto start = [&pool, &list, &container, dictionary, count, chunkItems, window, partData, doneData](int chunk) {
+                const int from = chunk * chunkItems;
+                const int to = qMin(count, from + chunkItems);
+                const int slot = chunk % window;
+                pool.start(makeTask([&list, &container, dictionary, from, to, slot, partData, doneData]() {
+                    JsonWriter part(container, from == 0);
+                    for (int i = from; i < to; ++i) {
+                        if (dictionary)
+                            part.key(list.at(i)->_key);
+                        toJson(list.at(i), part, false);
+                    }
+                    partData[slot] = part.take();
+                    doneData[slot].release();
+                }));
+            };
+
+            int started = 0;
+            while (started < window) {
+                start(started++);
+            }
+
+            for (int chunk = 0; chunk < chunkCount; ++chunk) {
+                const int slot = chunk % window;
+                doneData[slot].acquire();
+                writer.append(partData[slot]);
+                partData[slot] = QByteArray();
+
+                // The slot is free for the chunk after the window
+                if (started < chunkCount)
+                    start(started++);
+            }
+        }
+        else {
+            for (const Bencode *item: list) {
+                if (dictionary)
+                    writer.key(item->_key);
+                toJson(item, writer, parallel);
+            }
+        }
+
+        if (dictionary)
+            writer.endDictionary();
+        else
+            writer.endList();
+        break; }
+
+    case Integer:
+        writer.integer(bencode->_integer);
+        break;
+
+    default:
+#ifdef DEBUG
+        qDebug() << "wrong bencode type" << bencode->_type;
+#endif
+        writer.null();
+        break;
+    }
+}
@@ -26,9 +26,17 @@
 #include <QVariant>
 #include <QMap>
 #include <QList>
+#include <QSharedPointer>
+
+class QIODevice;
+class JsonWriter;
+class KeyTable;
 
 class Bencode : public AbstractTreeNode<Bencode>
 {
+    // Calls hooks
+    friend class AbstractTreeNode<Bencode>;
+
 public:
     enum Type {
         Invalid,
@@ -42,20 +50,45 @@ public:
         Dictionary
     };
 
+    enum class JsonFormat
+    {
+        Indented,
+        Compact
+    };
+
+    // How hex strings (pieces, signatures...) are written to JSON.
+    // Hex and Base64 are written as {"$hex": "..."} and {"$base64": "..."}.
+    enum class BlobEncoding
+    {
+        Escaped,
+        Hex,
+        Base64
+    };
+
+    // Parallel parses children of large lists and dictionaries
+    // (resume.dat entries, files of huge torrents) on a thread pool
+    enum class ParseMode
+    {
+        Serial,
+        Parallel
+    };
+
     Bencode(Type type = Type::Invalid, const QByteArray &key = QByteArray());
     Bencode(qlonglong integer, const QByteArray &key = QByteArray());
     Bencode(const QByteArray &string, const QByteArray &key = QByteArray());
+    ~Bencode();
 
     void setType(Type type);
     inline Type type() const { return _type; }
 
-    inline void setInteger(qlonglong integer) { _integer = integer; }
-    inline qlonglong integer() const { return _integer; }
+    // Value is stored only for the matching type
+    inline void setInteger(qlonglong integer) { if (isInteger()) { _integer = integer; invalidateFingerprint(); } }
+    inline qlonglong integer() const { return isInteger() ? _integer : 0; }
 
-    inline void setString(const QByteArray &string) { _string = string; }
-    inline QByteArray string() const { return _string; }
+    inline void setString(const QByteArray &string) { if (isString()) { _string = string; invalidateFingerprint(); } }
+    inline QByteArray string() const { return isString() ? _string : QByteArray(); }
 
-    inline void setKey(const QByteArray &key) { _key = key; }
+    void setKey(const QByteArray &key);
     inline QByteArray key() const { return _key; }
 
     inline void setHex(bool hex) { _hex = hex; }
@@ -83,34 +116,164 @@ public:
     QByteArray toRaw() const;
     QVariant toJson() const;
 
-    static Bencode *fromRaw(const QByteArray &raw);
+    // Writes JSON straight to the device without QVariant intermediate
+    bool toJson(QIODevice *device, JsonFormat format = JsonFormat::Indented, BlobEncoding blobEncoding = BlobEncoding::Escaped) const;
+    // Converts raw bencode to JSON without building items
+    static bool rawToJson(const QByteArray &raw, QIODevice *device, JsonFormat format = JsonFormat::Indented, BlobEncoding blobEncoding = BlobEncoding::Escaped);
+
+    // Raw dictionary item. Key starts at keyBegin, value is [begin, end).
+    struct RawSpan
+    {
+        QByteArray key;
+        int keyBegin;
+        int begin;
+        int end;
+    };
+
+    // Splits raw dictionary at pos to items without parsing of values.
+    // Allows to change some items and copy the rest byte to byte.
+    // end is set to the position after the dictionary.
+    static bool dictionarySpans(const QByteArray &raw, QList<RawSpan> &spans, int pos = 0, int *end = nullptr);
+    // Span with key or nullptr
+    static const RawSpan *findSpan(const QList<RawSpan> &spans, const QByteArray &key);
+
+    // Result of checking raw data which may be cut, e.g. a stream read by chunks
+    enum class ScanResult
+    {
+        Complete,
+        // Item is cut by the end of raw. More data may complete it.
+        Incomplete,
+        Invalid
+    };
+
+    // Checks syntax of the item at pos without building it.
+    // end is set to the position after a complete item.
+    static ScanResult scanItem(const QByteArray &raw, int pos, int *end);
+
+    static Bencode *fromRaw(const QByteArray &raw, ParseMode mode = ParseMode::Serial);
     static Bencode *fromJson(const QVariant &json);
+
+    // Parses JSON text without QVariant intermediate. Returns nullptr on error.
+    static Bencode *fromJson(const QByteArray &json, QString *errorString = nullptr, int *errorOffset = nullptr);
+
+    // Takes ownership of the tree and makes it read-only shared storage.
+    // Returned item and all its clones copy children from the storage
+    // only when they are accessed. So clone() of a not touched item is O(1)
+    // and changing of an item copies only the path from the root to it.
+    static Bencode *share(Bencode *bencode);
     static QString typeToStr(Type type);
 
+    // 128 bit hash of the subtree content. Key of the item itself is not
+    // counted but keys of dictionary items are. Cached and recalculated only
+    // when the subtree was changed.
+    struct Fingerprint
+    {
+        quint64 low;
+        quint64 high;
+
+        inline bool operator==(const Fingerprint &other) const { return low == other.low && high == other.high; }
+        inline bool operator!=(const Fingerprint &other) const { return !(*this == other); }
+    };
+
+    Fingerprint fingerprint() const;
+
+    // Different fingerprints reject containers without a tree walk
     bool compare(const Bencode *other) const;
 
-    // reimplemented
-    Bencode *clone() const override;
-    QString toString() const override;
+    // Approximate memory of the subtree. Shared storage is counted as own.
+    qint64 byteSize() const;
+
+    Bencode *clone() const;
+    QString toString() const;
+
+protected:
+    // AbstractTreeNode hooks
+    void childrenChanged();
+    void fetchChildren() const;
 
 private:
-    static Bencode *parseItem(const QByteArray &raw, int &pos);
+    Q_DISABLE_COPY(Bencode)
+
+    // Shared storage item which children are not fetched from yet
+    struct SharedContent
+    {
+        SharedContent()
+            : item(nullptr)
+            , storage()
+        {
+        }
+
+        const Bencode *item;
+        QSharedPointer<Bencode> storage;
+    };
+
+    void initValue();
+    void destroyValue();
+
+    static Bencode *shareItem(const Bencode *item, const QSharedPointer<Bencode> &storage);
+
+    // Children, shared storage and cached fingerprint. Allocated only for
+    // containers, so leaves keep just the parent, key, value and type.
+    struct Container
+    {
+        Container()
+            : children()
+            , shared()
+            , fingerprint()
+            , fingerprintValid(false)
+        {
+        }
+
+        QList<Bencode*> children;
+        SharedContent shared;
+        Fingerprint fingerprint;
+        bool fingerprintValid;
+    };
+
+    inline bool isContainer() const { return _type == List || _type == Dictionary; }
+    inline const Bencode *sharedItem() const { return isContainer() ? _container->shared.item : nullptr; }
+
+    // AbstractTreeNode children storage
+    inline QList<Bencode*> *childList() { return isContainer() ? &_container->children : nullptr; }
+    inline const QList<Bencode*> *childList() const { return isContainer() ? &_container->children : nullptr; }
+
+    // Item which children are stored. Does not fetch shared children.
+    inline const Bencode *content() const { return sharedItem() ? sharedItem() : this; }
+    inline const QList<Bencode*> &items() const { return content()->fetchedChildren(); }
+
+    void invalidateFingerprint();
+    bool compareContent(const Bencode *other) const;
+
+    static Bencode *parseItem(const QByteArray &raw, int &pos, KeyTable &keys, ParseMode mode = ParseMode::Serial);
+    static Bencode *parseParallel(const QByteArray &raw, int &pos, KeyTable &keys);
+    static bool skipItem(const QByteArray &raw, int &pos);
+    static ScanResult scanValue(const QByteArray &raw, int &pos, int depth);
 
     static Bencode *parseInteger(const QByteArray &raw, int &pos);
+    static bool parseStringData(const QByteArray &raw, int &pos, int &begin, int &size);
     static Bencode *parseString(const QByteArray &raw, int &pos);
-    static Bencode *parseList(const QByteArray &raw, int &pos);
-    static Bencode *parseDictionary(const QByteArray &raw, int &pos);
+    static Bencode *parseList(const QByteArray &raw, int &pos, KeyTable &keys, ParseMode mode);
+    static Bencode *parseDictionary(const QByteArray &raw, int &pos, KeyTable &keys, ParseMode mode);
 
     static QString fromRawString(const QByteArray &raw);
     static QByteArray toRawString(const QString &string);
 
+    // Wide containers are serialized on a thread pool if parallel is set
     static QByteArray toRaw(const Bencode *bencode);
+    static qint64 rawSize(const Bencode *bencode, bool parallel);
+    static char *writeRaw(const Bencode *bencode, char *out, bool parallel);
     static QVariant toJson(const Bencode *bencode);
+    static void toJson(const Bencode *bencode, JsonWriter &writer, bool parallel);
 
-    Type _type;
-
-    qlonglong _integer;
-    QByteArray _string;
     QByteArray _key;
+
+    // Only value of the current type is stored
+    union {
+        qlonglong _integer;     // Integer and Invalid
+        QByteArray _string;     // String
+        Container *_container;  // List and Dictionary, owned
+    };
+
+    Type _type;
     bool _hex;
 };
@@ -29,38 +29,152 @@
 #include <QDebug>
 #include <QUrl>
 
+namespace {
+
+// Edits of the same value closer in time are one typing run
+const qint64 TypingInterval = 1000;
+
+// Default memory limit of the undo history
+const qint64 UndoMemoryLimit = 64 * 1024 * 1024;
+
+} // namespace
+
+struct BencodeModel::UndoCommand
+{
+    enum Type {
+        Insert,          // insert item to the parent at row
+        Remove,          // remove item at row from the parent
+        Move,            // move item at row of the parent to toRow
+        SetValue,        // set integer or string of the item
+        SetHex,          // set hex flag of the item
+        SetKey,          // set key of the item at row of the parent
+        Replace,         // replace item at row of the parent
+        ReplaceDocument, // replace the whole document
+        Group            // several commands as one step, undone from the last
+    };
+
+    explicit UndoCommand(Type commandType)
+        : type(commandType)
+        , path()
+        , row(0)
+        , toRow(0)
+        , item(nullptr)
+        , integer(0)
+        , string()
+        , key()
+        , hex(false)
+        , commands()
+        , time(QDateTime::currentMSecsSinceEpoch())
+        , bytes(0)
+    {
+    }
+
+    ~UndoCommand()
+    {
+        delete item;
+        qDeleteAll(commands);
+    }
+
+    // Typing in the same value is undone at once
+    bool canMerge(const UndoCommand *other) const
+    {
+        if (type != other->type || other->time - time > TypingInterval)
+            return false;
+
+        switch (type) {
+        case SetValue:
+            return path == other->path;
+
+        case Group:
+            if (commands.size() != other->commands.size())
+                return false;
+
+            for (int i = 0; i < commands.size(); i++) {
+                const UndoCommand *command = commands.at(i);
+                const UndoCommand *otherCommand = other->commands.at(i);
+                if (command->type != SetValue || otherCommand->type != SetValue || command->path != otherCommand->path)
+                    return false;
+            }
+            return true;
+
+        default:
+            return false;
+        }
+    }
+
+    // Approximate memory used by the command
+    qint64 byteSize() const
+    {
+        qint64 res = sizeof(UndoCommand) + path.size() * sizeof(int) + string.size() + key.size();
+        if (item)
+            res += item->byteSize();
+
+        for (const UndoCommand *command: commands) {
+            res += command->byteSize();
+        }
+        return res;
+    }
+
+    Type type;
+    QList<int> path; // rows from the model root to the parent or to the item for SetValue/SetHex
+    int row;
+    int toRow;
+    Bencode *item; // owned
+    qlonglong integer;
+    QByteArray string;
+    QByteArray key;
+    bool hex;
+    QList<UndoCommand*> commands;
+    qint64 time; // last edit of the typing run
+    qint64 bytes; // byteSize() when put to a stack
+};
+
+static int keyRow(const Bencode *dictionary, const QByteArray &key)
+{
+    int row = 0;
+    while (row < dictionary->childCount() && !(key < dictionary->child(row)->key())) {
+        row++;
+    }
+    return row;
+}
+
 BencodeModel::BencodeModel(QObject *parent)
     : AbstractTreeModel(new Bencode(Bencode::Type::Dictionary), parent)
     , _bencode(new Bencode(Bencode::Type::Dictionary, "root"))
     , _originBencode(new Bencode(Bencode::Type::Dictionary, "root"))
     , _textCodec(QTextCodec::codecForName("UTF-8"))
+    , _undoStack()
+    , _redoStack()
+    , _undoGroup(nullptr)
+    , _undoGroupLevel(0)
+    , _undoLimit(100)
+    , _undoMemoryLimit(UndoMemoryLimit)
+    , _undoBytes(0)
 {
     root()->appendChild(_bencode);
 }
 
 BencodeModel::~BencodeModel()
 {
+    clearUndo();
+    delete _undoGroup;
     delete _bencode;
     delete _originBencode;
 }
 
 void BencodeModel::setJson(const QVariant &json)
 {
-    Bencode *newBencode = Bencode::fromJson(json);
-    if (newBencode && newBencode->compare(_bencode)) {
-        delete newBencode;
-        return;
-    }
+    setBencode(Bencode::fromJson(json));
+}
 
-    removeRows(0, rowCount());
-    _bencode = newBencode;
-    if (!_bencode)
-        _bencode = new Bencode(Bencode::Type::Dictionary);
-    _bencode->setKey("root");
+bool BencodeModel::setJson(const QByteArray &json, QString *errorString, int *errorOffset)
+{
+    Bencode *newBencode = Bencode::fromJson(json, errorString, errorOffset);
+    if (!newBencode)
+        return false;
 
-    beginInsertRows(QModelIndex(), 0, 0);
-    root()->appendChild(_bencode);
-    endInsertRows();
+    setBencode(newBencode);
+    return true;
 }
 
 QVariant BencodeModel::toJson() const
@@ -68,28 +182,37 @@ QVariant BencodeModel::toJson() const
     return _bencode ? _bencode->toJson() : QVariant();
 }
 
+bool BencodeModel::toJson(QIODevice *device, Bencode::JsonFormat format, Bencode::BlobEncoding blobEncoding) const
+{
+    return _bencode ? _bencode->toJson(device, format, blobEncoding) : false;
+}
+
 void BencodeModel::setRaw(const QByteArray &raw)
 {
-    Bencode *newBencode = Bencode::fromRaw(raw);
+    setBencode(Bencode::fromRaw(raw, Bencode::ParseMode::Parallel));
+}
+
+QByteArray BencodeModel::toRaw() const
+{
+    return _bencode->toRaw();
+}
+
+void BencodeModel::setBencode(Bencode *newBencode)
+{
     if (newBencode && newBencode->compare(_bencode)) {
         delete newBencode;
         return;
     }
 
-    removeRows(0, rowCount());
-    _bencode = newBencode;
-    if (!_bencode)
-        _bencode = new Bencode(Bencode::Type::Dictionary);
-    _bencode->setKey("root");
+    newBencode = newBencode ? Bencode::share(newBencode) : new Bencode(Bencode::Type::Dictionary);
+    newBencode->setKey("root");
 
-    beginInsertRows(QModelIndex(), 0, 0);
-    root()->appendChild(_bencode);
-    endInsertRows();
-}
-
-QByteArray BencodeModel::toRaw() const
-{
-    return _bencode->toRaw();
+    Bencode *oldBencode = replaceBencode(newBencode);
+    if (oldBencode) {
+        UndoCommand *command = new UndoCommand(UndoCommand::ReplaceDocument);
+        command->item = oldBencode;
+        addUndo(command);
+    }
 }
 
 bool BencodeModel::isValid() const
@@ -114,6 +237,95 @@ bool BencodeModel::isModified() const
     return _bencode ? !_bencode->compare(_originBencode) : false;
 }
 
+bool BencodeModel::canUndo() const
+{
+    return !_undoStack.isEmpty();
+}
+
+bool BencodeModel::canRedo() const
+{
+    return !_redoStack.isEmpty();
+}
+
+void BencodeModel::clearUndo()
+{
+    qDeleteAll(_undoStack);
+    _undoStack.clear();
+    qDeleteAll(_redoStack);
+    _redoStack.clear();
+    _undoBytes = 0;
+}
+
+void BencodeModel::setUndoLimit(int limit)
+{
+    _undoLimit = limit;
+    if (isUndoEnabled())
+        trimUndo();
+    else
+        clearUndo();
+}
+
+int BencodeModel::undoLimit() const
+{
+    return _undoLimit;
+}
+
+void BencodeModel::setUndoMemoryLimit(qint64 bytes)
+{
+    _undoMemoryLimit = bytes;
+    trimUndo();
+}
+
+qint64 BencodeModel::undoMemoryLimit() const
+{
+    return _undoMemoryLimit;
+}
+
+void BencodeModel::beginUndoGroup()
+{
+    if (!_undoGroupLevel++)
+        _undoGroup = new UndoCommand(UndoCommand::Group);
+}
+
+void BencodeModel::endUndoGroup()
+{
+    Q_ASSERT(_undoGroupLevel > 0);
+    if (--_undoGroupLevel)
+        return;
+
+    UndoCommand *group = _undoGroup;
+    _undoGroup = nullptr;
+
+    if (group->commands.isEmpty()) {
+        delete group;
+    }
+    else if (group->commands.size() == 1) {
+        UndoCommand *command = group->commands.takeFirst();
+        delete group;
+        addUndo(command);
+    }
+    else {
+        addUndo(group);
+    }
+}
+
+void BencodeModel::undo()
+{
+    if (_undoStack.isEmpty() || _undoGroup)
+        return;
+
+    pushStack(_redoStack, apply(takeStack(_undoStack)));
+}
+
+void BencodeModel::redo()
+{
+    if (_redoStack.isEmpty() || _undoGroup)
+        return;
+
+    pushStack(_undoStack, apply(takeStack(_redoStack)));
+    trimUndo();
+}
+
 void BencodeModel::setTextCodec(QTextCodec *textCodec)
 {
     _textCodec = textCodec;
@@ -127,17 +339,12 @@ QTextCodec *BencodeModel::textCodec() const
 
 void BencodeModel::setName(const QString &name)
 {
-    if (name.isEmpty() && _bencode && _bencode->child("info") && _bencode->child("info")->child("name")) { // -V807 PVS-Studio
-        removeRow(_bencode->child("info")->child("name")->row(), nodeToIndex(_bencode->child("info")));
-        if (!_bencode->child("info")->childCount()) {
-            removeRow(_bencode->child("info")->row(), nodeToIndex(_bencode));
-        }
-    }
-    else if (!name.isEmpty()) {
-        emit layoutAboutToBeChanged();
-        _bencode->checkAndCreate(Bencode::Type::Dictionary, "info")->checkAndCreate(Bencode::Type::String, "name")->setString(fromUnicode(name));
-        emit layoutChanged();
-    }
+    beginUndoGroup();
+    if (name.isEmpty())
+        removeInfoItem("name");
+    else
+        setItemString(mapItem(mapItem(_bencode, Bencode::Type::Dictionary, "info"), Bencode::Type::String, "name"), fromUnicode(name));
+    endUndoGroup();
 }
 
 QString BencodeModel::name() const
@@ -150,17 +357,12 @@ QString BencodeModel::name() const
 
 void BencodeModel::setPrivateTorrent(bool privateTorrent)
 {
-    if (!privateTorrent && _bencode && _bencode->child("info") && _bencode->child("info")->child("private")) { // -V807 PVS-Studio
-        removeRow(_bencode->child("info")->child("private")->row(), nodeToIndex(_bencode->child("info")));
-        if (!_bencode->child("info")->childCount()) {
-            removeRow(_bencode->child("info")->row(), nodeToIndex(_bencode));
-        }
-    }
-    else if (privateTorrent) {
-        emit layoutAboutToBeChanged();
-        _bencode->checkAndCreate(Bencode::Type::Dictionary, "info")->checkAndCreate(Bencode::Type::Integer, "private")->setInteger(1);
-        emit layoutChanged();
-    }
+    beginUndoGroup();
+    if (!privateTorrent)
+        removeInfoItem("private");
+    else
+        setItemInteger(mapItem(mapItem(_bencode, Bencode::Type::Dictionary, "info"), Bencode::Type::Integer, "private"), 1);
+    endUndoGroup();
 }
 
 bool BencodeModel::privateTorrent() const
@@ -173,14 +375,12 @@ bool BencodeModel::privateTorrent() const
 
 void BencodeModel::setUrl(const QString &url)
 {
-    if (url.isEmpty() && _bencode && _bencode->child("publisher-url")) {
-        removeRow(_bencode->child("publisher-url")->row(), nodeToIndex(_bencode));
-    }
-    else if (!url.isEmpty()) {
-        emit layoutAboutToBeChanged();
-        _bencode->checkAndCreate(Bencode::Type::String, "publisher-url")->setString(fromUnicode(url));
-        emit layoutChanged();
-    }
+    beginUndoGroup();
+    if (url.isEmpty())
+        removeTopItem("publisher-url");
+    else
+        setItemString(mapItem(_bencode, Bencode::Type::String, "publisher-url"), fromUnicode(url));
+    endUndoGroup();
 }
 
 QString BencodeModel::url() const
@@ -193,14 +393,12 @@ QString BencodeModel::url() const
 
 void BencodeModel::setPublisher(const QString &publisher)
 {
-    if (publisher.isEmpty() && _bencode && _bencode->child("publisher")) {
-        removeRow(_bencode->child("publisher")->row(), nodeToIndex(_bencode));
-    }
-    else if (!publisher.isEmpty()) {
-        emit layoutAboutToBeChanged();
-        _bencode->checkAndCreate(Bencode::Type::String, "publisher")->setString(fromUnicode(publisher));
-        emit layoutChanged();
-    }
+    beginUndoGroup();
+    if (publisher.isEmpty())
+        removeTopItem("publisher");
+    else
+        setItemString(mapItem(_bencode, Bencode::Type::String, "publisher"), fromUnicode(publisher));
+    endUndoGroup();
 }
 
 QString BencodeModel::publisher() const
@@ -213,14 +411,12 @@ QString BencodeModel::publisher() const
 
 void BencodeModel::setCreatedBy(const QString &createdBy)
 {
-    if (createdBy.isEmpty() && _bencode && _bencode->child("created by")) {
-        removeRow(_bencode->child("created by")->row(), nodeToIndex(_bencode));
-    }
-    else if (!createdBy.isEmpty()) {
-        emit layoutAboutToBeChanged();
-        _bencode->checkAndCreate(Bencode::Type::String, "created by")->setString(fromUnicode(createdBy));
-        emit layoutChanged();
-    }
+    beginUndoGroup();
+    if (createdBy.isEmpty())
+        removeTopItem("created by");
+    else
+        setItemString(mapItem(_bencode, Bencode::Type::String, "created by"), fromUnicode(createdBy));
+    endUndoGroup();
 }
 
 QString BencodeModel::createdBy() const
@@ -233,14 +429,12 @@ QString BencodeModel::createdBy() const
 
 void BencodeModel::setCreationTime(const QDateTime &creationTime)
 {
-    if (!creationTime.isValid() && _bencode && _bencode->child("creation date")) {
-        removeRow(_bencode->child("creation date")->row(), nodeToIndex(_bencode));
-    }
-    else if (creationTime.isValid()) {
-        emit layoutAboutToBeChanged();
-        _bencode->checkAndCreate(Bencode::Type::Integer, "creation date")->setInteger(static_cast<qlonglong>(creationTime.toMSecsSinceEpoch() / 1000));
-        emit layoutChanged();
-    }
+    beginUndoGroup();
+    if (!creationTime.isValid())
+        removeTopItem("creation date");
+    else
+        setItemInteger(mapItem(_bencode, Bencode::Type::Integer, "creation date"), static_cast<qlonglong>(creationTime.toMSecsSinceEpoch() / 1000));
+    endUndoGroup();
 }
 
 QDateTime BencodeModel::creationTime() const
@@ -253,17 +447,12 @@ QDateTime BencodeModel::creationTime() const
 
 void BencodeModel::setPieceSize(int pieceSize)
 {
-    if (!pieceSize && _bencode && _bencode->child("info") && _bencode->child("info")->child("piece length")) { // -V807 PVS-Studio
-        removeRow(_bencode->child("info")->child("piece length")->row(), nodeToIndex(_bencode->child("info")));
-        if (!_bencode->child("info")->childCount()) {
-            removeRow(_bencode->child("info")->row(), nodeToIndex(_bencode));
-        }
-    }
-    else if (pieceSize) {
-        emit layoutAboutToBeChanged();
-        _bencode->checkAndCreate(Bencode::Type::Dictionary, "info")->checkAndCreate(Bencode::Type::Integer, "piece length")->setInteger(pieceSize);
-        emit layoutChanged();
-    }
+    beginUndoGroup();
+    if (!pieceSize)
+        removeInfoItem("piece length");
+    else
+        setItemInteger(mapItem(mapItem(_bencode, Bencode::Type::Dictionary, "info"), Bencode::Type::Integer, "piece length"), pieceSize);
+    endUndoGroup();
 }
 
 int BencodeModel::pieceSize() const
@@ -310,14 +499,12 @@ QString BencodeModel::magnetLink() const
 
 void BencodeModel::setComment(const QString &comment)
 {
-    if (comment.isEmpty() && _bencode && _bencode->child("comment")) {
-        removeRow(_bencode->child("comment")->row(), nodeToIndex(_bencode));
-    }
-    else if (!comment.isEmpty()) {
-        emit layoutAboutToBeChanged();
-        _bencode->checkAndCreate(Bencode::Type::String, "comment")->setString(fromUnicode(comment));
-        emit layoutChanged();
-    }
+    beginUndoGroup();
+    if (comment.isEmpty())
+        removeTopItem("comment");
+    else
+        setItemString(mapItem(_bencode, Bencode::Type::String, "comment"), fromUnicode(comment));
+    endUndoGroup();
 }
 
 QString BencodeModel::comment() const
@@ -330,30 +517,43 @@ QString BencodeModel::comment() const
 
 void BencodeModel::setTrackers(const QStringList &trackers)
 {
-    if (_bencode->child("announce-list"))
-        removeRow(_bencode->child("announce-list")->row(), nodeToIndex(_bencode));
+    QList<QByteArray> urls;
+    for (const QString &tracker: trackers) {
+        if (!tracker.trimmed().isEmpty())
+            urls << fromUnicode(tracker);
+    }
 
-    emit layoutAboutToBeChanged();
-    _bencode->appendMapItem(new Bencode(Bencode::Type::List, "announce-list"));
+    beginUndoGroup();
+    if (urls.isEmpty()) {
+        removeTopItem("announce-list");
+        removeTopItem("announce");
+        endUndoGroup();
+        return;
+    }
 
-    for (const QString &tracker: trackers) {
-        if (tracker.trimmed().isEmpty())
+    // Only changed tiers are touched
+    Bencode *list = mapItem(_bencode, Bencode::Type::List, "announce-list");
+    for (int i = 0; i < urls.size(); i++) {
+        Bencode *tier = i < list->childCount() ? list->child(i) : nullptr;
+        if (tier && tier->isList() && tier->childCount() == 1 && tier->child(0)->isString()) {
+            setItemString(tier->child(0), urls.at(i));
             continue;
+        }
 
-        Bencode *item = new Bencode(fromUnicode(tracker));
-        Bencode *parentItem = new Bencode(Bencode::Type::List);
-        parentItem->appendChild(item);
-        _bencode->child("announce-list")->appendChild(parentItem); // -V595 // -V807 PVS-Studio
-    }
+        if (tier)
+            removeItem(tier);
 
-    if (_bencode->child("announce-list") && !_bencode->child("announce-list")->children().isEmpty()) {
-        _bencode->checkAndCreate(Bencode::Type::String, "announce")->setString(_bencode->child("announce-list")->child(0)->child(0)->string());
+        tier = new Bencode(Bencode::Type::List);
+        tier->appendChild(new Bencode(urls.at(i)));
+        insertItem(list, i, tier);
     }
-    else {
-        delete _bencode->child("announce-list");
-        delete _bencode->child("announce");
+
+    while (list->childCount() > urls.size()) {
+        removeItem(list->child(list->childCount() - 1));
     }
-    emit layoutChanged();
+
+    setItemString(mapItem(_bencode, Bencode::Type::String, "announce"), urls.first());
+    endUndoGroup();
 }
 
 QStringList BencodeModel::trackers() const
@@ -379,15 +579,19 @@ QStringList BencodeModel::trackers() const
 
 void BencodeModel::setFiles(const QList<QPair<QString, qlonglong>> &files)
 {
-    emit layoutAboutToBeChanged();
+    beginUndoGroup();
+    Bencode *info = mapItem(_bencode, Bencode::Type::Dictionary, "info");
 
     if (files.size() == 1) {
         qlonglong totalSize = files.first().second;
-        _bencode->child("info")->checkAndCreate(Bencode::Type::Integer, "length")->setInteger(totalSize);
+        setItemInteger(mapItem(info, Bencode::Type::Integer, "length"), totalSize);
     }
     else {
-        delete _bencode->child("info")->child("files");
-        _bencode->child("info")->appendMapItem(new Bencode(Bencode::Type::List, "files"));
+        if (info->child("files"))
+            removeItem(info->child("files"));
+
+        // New list is built outside of the model and inserted at once
+        Bencode *list = new Bencode(Bencode::Type::List, "files");
         for (const auto &filePair: files) {
             QString file = filePair.first;
             qlonglong size = filePair.second;
@@ -400,11 +604,11 @@ void BencodeModel::setFiles(const QList<QPair<QString, qlonglong>> &files)
             for (const QString &path: pathList) {
                 fileItem->child("path")->appendChild(new Bencode(fromUnicode(path)));
             }
-            _bencode->child("info")->child("files")->appendChild(fileItem);
+            list->appendChild(fileItem);
         }
+        insertMapItem(info, list);
     }
-
-    emit layoutChanged();
+    endUndoGroup();
 }
 
 QList<QPair<QString, qlonglong>> BencodeModel::files() const
@@ -494,23 +698,19 @@ qulonglong BencodeModel::totalSize() const
 void BencodeModel::setPieces(const QByteArray &pieces)
 {
     if (!pieces.isEmpty()) {
-        emit layoutAboutToBeChanged();
-        if (!_bencode->child("info"))
-            _bencode->appendMapItem(new Bencode(Bencode::Type::Dictionary, "info"));
-
-        if (!_bencode->child("info")->child("pieces"))
-            _bencode->child("info")->appendMapItem(new Bencode("", "pieces"));
-
-        _bencode->child("info")->child("pieces")->setString(pieces);
-        _bencode->child("info")->child("pieces")->setHex(true);
-        emit layoutChanged();
+        beginUndoGroup();
+        Bencode *item = mapItem(mapItem(_bencode, Bencode::Type::Dictionary, "info"), Bencode::Type::String, "pieces");
+        setItemString(item, pieces);
+        setItemHex(item, true);
+        endUndoGroup();
     }
     else {
-        removeRows(0, rowCount());
-        _bencode = new Bencode(Bencode::Type::Dictionary, "root");
-        beginInsertRows(QModelIndex(), 0, 0);
-        root()->appendChild(_bencode);
-        endInsertRows();
+        Bencode *oldBencode = replaceBencode(new Bencode(Bencode::Type::Dictionary, "root"));
+        if (oldBencode) {
+            UndoCommand *command = new UndoCommand(UndoCommand::ReplaceDocument);
+            command->item = oldBencode;
+            addUndo(command);
+        }
     }
 }
 
@@ -529,6 +729,12 @@ void BencodeModel::up(const QModelIndex &index)
     beginMoveRows(index.parent(), index.row(), index.row(), index.parent(), index.row() - 1);
     item->setRow(index.row() - 1);
     endMoveRows();
+
+    UndoCommand *command = new UndoCommand(UndoCommand::Move);
+    command->path = nodeToPath(item->parent());
+    command->row = item->row();
+    command->toRow = item->row() + 1;
+    addUndo(command);
 }
 
 void BencodeModel::down(const QModelIndex &index)
@@ -546,6 +752,12 @@ void BencodeModel::down(const QModelIndex &index)
     beginMoveRows(index.parent(), index.row(), index.row(), index.parent(), index.row() + 2);
     item->setRow(index.row() + 1);
     endMoveRows();
+
+    UndoCommand *command = new UndoCommand(UndoCommand::Move);
+    command->path = nodeToPath(item->parent());
+    command->row = item->row();
+    command->toRow = item->row() - 1;
+    addUndo(command);
 }
 
 void BencodeModel::appendRow(const QModelIndex &parent)
@@ -578,6 +790,14 @@ void BencodeModel::changeType(const QModelIndex &index, Bencode::Type type)
     if (!bencode || bencode->type() == type)
         return;
 
+    if (isUndoEnabled()) {
+        UndoCommand *command = new UndoCommand(UndoCommand::Replace);
+        command->path = nodeToPath(bencode->parent());
+        command->row = bencode->row();
+        command->item = bencode->clone();
+        addUndo(command);
+    }
+
     emit layoutAboutToBeChanged();
     bencode->setType(type);
     emit layoutChanged();
@@ -602,32 +822,23 @@ bool BencodeModel::setData(const QModelIndex &index, const QVariant &value, int
 
     bool res = false;
 
+    qlonglong oldInteger = item->integer();
+    QByteArray oldString = item->string();
+    bool oldHex = item->hex();
+
     switch (role) {
     case Qt::EditRole:
         if (column == Column::Name) {
-            QByteArray newKey = fromUnicode(value.toString());
-            Bencode *parentItem = item->parent();
-            int newRow;
-            for (newRow = 0; newRow < parentItem->childCount(); newRow++) {
-
-                if (newKey < parentItem->child(newRow)->key()) {
-                    break;
-                }
-            }
-
-            // Fixed new item pos when going to right
-            int realRow = newRow > item->row() ? newRow - 1 : newRow;
-
-            item->setKey(newKey);
+            QByteArray oldKey = item->key();
+            int row = changeKey(index, fromUnicode(value.toString()));
             res = true;
 
-            if (realRow == item->row()) {
-                emit dataChanged(index, index);
-            }
-            else {
-                beginMoveRows(index.parent(), index.row(), index.row(), index.parent(), newRow);
-                item->setRow(realRow);
-                endMoveRows();
+            if (item->key() != oldKey) {
+                UndoCommand *command = new UndoCommand(UndoCommand::SetKey);
+                command->path = nodeToPath(item->parent());
+                command->row = row;
+                command->key = oldKey;
+                addUndo(command);
             }
         }
         else if (column == Column::Value) {
@@ -675,6 +886,21 @@ bool BencodeModel::setData(const QModelIndex &index, const QVariant &value, int
         break;
     }
 
+    if (res && (item->integer() != oldInteger || item->string() != oldString)) {
+        UndoCommand *command = new UndoCommand(UndoCommand::SetValue);
+        command->path = nodeToPath(item);
+        command->integer = oldInteger;
+        command->string = oldString;
+        addUndo(command);
+    }
+
+    if (res && item->hex() != oldHex) {
+        UndoCommand *command = new UndoCommand(UndoCommand::SetHex);
+        command->path = nodeToPath(item);
+        command->hex = oldHex;
+        addUndo(command);
+    }
+
     return res;
 }
 
@@ -778,6 +1004,19 @@ bool BencodeModel::insertRows(int row, int count, const QModelIndex &parent)
         bencodeParent->insertChild(row, new Bencode(0));
     }
     endInsertRows();
+
+    if (!isUndoEnabled())
+        return true;
+
+    beginUndoGroup();
+    for (int i = 0; i < count; i++) {
+        UndoCommand *command = new UndoCommand(UndoCommand::Remove);
+        command->path = nodeToPath(bencodeParent);
+        command->row = row;
+        addUndo(command);
+    }
+    endUndoGroup();
+
     return true;
 }
 
@@ -788,15 +1027,30 @@ bool BencodeModel::removeRows(int row, int count, const QModelIndex &parent)
     if (bencodeParent->children().size() < row + count)
         return false;
 
+    QList<int> path = nodeToPath(bencodeParent);
+
+    beginUndoGroup();
     beginRemoveRows(parent, row, row + count - 1);
     for (int i = 0; i < count; i++) {
         Bencode *item = bencodeParent->child(row);
-        if (item == _bencode) {
-            _bencode = nullptr;
+        if (item == _bencode || !isUndoEnabled()) {
+            if (item == _bencode)
+                _bencode = nullptr;
+            delete item;
+            continue;
         }
-        delete item;
+
+        // Removed item is kept by undo command. Every item is removed
+        // from row and the commands are undone from the last.
+        item->setParent(nullptr);
+        UndoCommand *command = new UndoCommand(UndoCommand::Insert);
+        command->path = path;
+        command->row = row;
+        command->item = item;
+        addUndo(command);
     }
     endRemoveRows();
+    endUndoGroup();
 
     return true;
 }
@@ -847,3 +1101,337 @@ QByteArray BencodeModel::fromUnicode(const QString &unicode) const
 {
     return _textCodec->fromUnicode(unicode);
 }
+
+Bencode *BencodeModel::replaceBencode(Bencode *bencode)
+{
+    Bencode *oldBencode = _bencode;
+    if (oldBencode) {
+        beginRemoveRows(QModelIndex(), 0, 0);
+        oldBencode->setParent(nullptr);
+        _bencode = nullptr;
+        endRemoveRows();
+    }
+
+    if (bencode) {
+        beginInsertRows(QModelIndex(), 0, 0);
+        _bencode = bencode;
+        root()->appendChild(_bencode);
+        endInsertRows();
+    }
+
+    return oldBencode;
+}
+
+int BencodeModel::changeKey(const QModelIndex &index, const QByteArray &key)
+{
+    Bencode *item = indexToNode(index);
+    Bencode *parentItem = item->parent();
+    int newRow;
+    for (newRow = 0; newRow < parentItem->childCount(); newRow++) {
+
+        if (key < parentItem->child(newRow)->key()) {
+            break;
+        }
+    }
+
+    // Fixed new item pos when going to right
+    int realRow = newRow > item->row() ? newRow - 1 : newRow;
+
+    item->setKey(key);
+
+    if (realRow == item->row()) {
+        emit dataChanged(index, index);
+    }
+    else {
+        beginMoveRows(index.parent(), index.row(), index.row(), index.parent(), newRow);
+        item->setRow(realRow);
+        endMoveRows();
+    }
+
+    return realRow;
+}
+
+QList<int> BencodeModel::nodeToPath(Bencode *node) const
+{
+    QList<int> path;
+    while (node && node != root()) {
+        path.prepend(node->row());
+        node = node->parent();
+    }
+    return path;
+}
+
+Bencode *BencodeModel::pathToNode(const QList<int> &path) const
+{
+    Bencode *node = root();
+    for (int row: path) {
+        node = node->child(row);
+    }
+    return node;
+}
+
+Bencode *BencodeModel::mapItem(Bencode *parentItem, Bencode::Type type, const QByteArray &key)
+{
+    Bencode *item = parentItem->child(key);
+    if (item && item->type() == type)
+        return item;
+
+    if (item)
+        removeItem(item);
+
+    item = new Bencode(type, key);
+    insertMapItem(parentItem, item);
+    return item;
+}
+
+void BencodeModel::insertItem(Bencode *parentItem, int row, Bencode *item)
+{
+    beginInsertRows(nodeToIndex(parentItem), row, row);
+    parentItem->insertChild(row, item);
+    endInsertRows();
+
+    if (!isUndoEnabled())
+        return;
+
+    UndoCommand *command = new UndoCommand(UndoCommand::Remove);
+    command->path = nodeToPath(parentItem);
+    command->row = row;
+    addUndo(command);
+}
+
+void BencodeModel::insertMapItem(Bencode *parentItem, Bencode *item)
+{
+    insertItem(parentItem, keyRow(parentItem, item->key()), item);
+}
+
+void BencodeModel::removeItem(Bencode *item)
+{
+    removeRow(item->row(), nodeToIndex(item->parent()));
+}
+
+void BencodeModel::removeTopItem(const QByteArray &key)
+{
+    if (_bencode && _bencode->child(key))
+        removeItem(_bencode->child(key));
+}
+
+void BencodeModel::removeInfoItem(const QByteArray &key)
+{
+    Bencode *info = _bencode ? _bencode->child("info") : nullptr;
+    if (!info || !info->child(key))
+        return;
+
+    removeItem(info->child(key));
+    if (!info->childCount())
+        removeItem(info);
+}
+
+void BencodeModel::setItemInteger(Bencode *item, qlonglong integer)
+{
+    if (item->integer() == integer)
+        return;
+
+    if (isUndoEnabled()) {
+        UndoCommand *command = new UndoCommand(UndoCommand::SetValue);
+        command->path = nodeToPath(item);
+        command->integer = item->integer();
+        addUndo(command);
+    }
+
+    item->setInteger(integer);
+    QModelIndex index = nodeToIndex(item);
+    index = index.sibling(index.row(), static_cast<int>(Column::Value));
+    emit dataChanged(index, index);
+}
+
+void BencodeModel::setItemString(Bencode *item, const QByteArray &string)
+{
+    if (item->string() == string)
+        return;
+
+    if (isUndoEnabled()) {
+        UndoCommand *command = new UndoCommand(UndoCommand::SetValue);
+        command->path = nodeToPath(item);
+        command->string = item->string();
+        addUndo(command);
+    }
+
+    item->setString(string);
+    QModelIndex index = nodeToIndex(item);
+    index = index.sibling(index.row(), static_cast<int>(Column::Value));
+    emit dataChanged(index, index);
+}
+
+void BencodeModel::setItemHex(Bencode *item, bool hex)
+{
+    if (item->hex() == hex)
+        return;
+
+    if (isUndoEnabled()) {
+        UndoCommand *command = new UndoCommand(UndoCommand::SetHex);
+        command->path = nodeToPath(item);
+        command->hex = item->hex();
+        addUndo(command);
+    }
+
+    item->setHex(hex);
+    QModelIndex index = nodeToIndex(item);
+    emit dataChanged(index.sibling(index.row(), static_cast<int>(Column::Hex)), index.sibling(index.row(), static_cast<int>(Column::Value)));
+}
+
+bool BencodeModel::isUndoEnabled() const
+{
+    return _undoLimit > 0;
+}
+
+void BencodeModel::addUndo(UndoCommand *command)
+{
+    // Callers skip building expensive commands, the rest are dropped here
+    if (!isUndoEnabled()) {
+        delete command;
+        return;
+    }
+
+    if (_undoGroup) {
+        _undoGroup->commands.append(command);
+        return;
+    }
+
+    while (!_redoStack.isEmpty()) {
+        delete takeStack(_redoStack);
+    }
+
+    // Keep the oldest state of the typing run
+    if (!_undoStack.isEmpty() && _undoStack.last()->canMerge(command)) {
+        _undoStack.last()->time = command->time;
+        delete command;
+        return;
+    }
+
+    pushStack(_undoStack, command);
+    trimUndo();
+}
+
+void BencodeModel::pushStack(QList<UndoCommand*> &stack, UndoCommand *command)
+{
+    command->bytes = command->byteSize();
+    _undoBytes += command->bytes;
+    stack.append(command);
+}
+
+BencodeModel::UndoCommand *BencodeModel::takeStack(QList<UndoCommand*> &stack)
+{
+    UndoCommand *command = stack.takeLast();
+    _undoBytes -= command->bytes;
+    return command;
+}
+
+void BencodeModel::trimUndo()
+{
+    // The last step is kept even if it is bigger than the memory limit
+    while (!_undoStack.isEmpty() && (_undoStack.size() > _undoLimit || (_undoBytes > _undoMemoryLimit && _undoStack.size() > 1))) {
+        UndoCommand *command = _undoStack.takeFirst();
+        _undoBytes -= command->bytes;
+        delete command;
+    }
+}
+
+BencodeModel::UndoCommand *BencodeModel::apply(UndoCommand *command)
+{
+    UndoCommand *inverse = new UndoCommand(command->type);
+    inverse->path = command->path;
+    inverse->row = command->row;
+
+    switch (command->type) {
+    case UndoCommand::Insert: {
+        Bencode *parentItem = pathToNode(command->path);
+        beginInsertRows(nodeToIndex(parentItem), command->row, command->row);
+        parentItem->insertChild(command->row, command->item);
+        command->item = nullptr;
+        endInsertRows();
+        inverse->type = UndoCommand::Remove;
+        break; }
+
+    case UndoCommand::Remove: {
+        Bencode *parentItem = pathToNode(command->path);
+        beginRemoveRows(nodeToIndex(parentItem), command->row, command->row);
+        inverse->item = parentItem->child(command->row);
+        inverse->item->setParent(nullptr);
+        endRemoveRows();
+        inverse->type = UndoCommand::Insert;
+        break; }
+
+    case UndoCommand::Move: {
+        Bencode *parentItem = pathToNode(command->path);
+        QModelIndex parentIndex = nodeToIndex(parentItem);
+        int destination = command->toRow > command->row ? command->toRow + 1 : command->toRow;
+        beginMoveRows(parentIndex, command->row, command->row, parentIndex, destination);
+        parentItem->child(command->row)->setRow(command->toRow);
+        endMoveRows();
+        inverse->row = command->toRow;
+        inverse->toRow = command->row;
+        break; }
+
+    case UndoCommand::SetValue: {
+        Bencode *item = pathToNode(command->path);
+        inverse->integer = item->integer();
+        inverse->string = item->string();
+        if (item->isInteger())
+            item->setInteger(command->integer);
+        else if (item->isString())
+            item->setString(command->string);
+
+        QModelIndex index = nodeToIndex(item);
+        index = index.sibling(index.row(), static_cast<int>(Column::Value));
+        emit dataChanged(index, index);
+        break; }
+
+    case UndoCommand::SetHex: {
+        Bencode *item = pathToNode(command->path);
+        inverse->hex = item->hex();
+        item->setHex(command->hex);
+
+        QModelIndex index = nodeToIndex(item);
+        emit dataChanged(index.sibling(index.row(), static_cast<int>(Column::Hex)), index.sibling(index.row(), static_cast<int>(Column::Value)));
+        break; }
+
+    case UndoCommand::SetKey: {
+        Bencode *item = pathToNode(command->path)->child(command->row);
+        inverse->key = item->key();
+        inverse->row = changeKey(nodeToIndex(item), command->key);
+        break; }
+
+    case UndoCommand::Replace: {
+        Bencode *parentItem = pathToNode(command->path);
+        QModelIndex parentIndex = nodeToIndex(parentItem);
+
+        beginRemoveRows(parentIndex, command->row, command->row);
+        inverse->item = parentItem->child(command->row);
+        inverse->item->setParent(nullptr);
+        endRemoveRows();
+
+        beginInsertRows(parentIndex, command->row, command->row);
+        parentItem->insertChild(command->row, command->item);
+        command->item = nullptr;
+        endInsertRows();
+        break; }
+
+    case UndoCommand::ReplaceDocument:
+        inverse->item = replaceBencode(command->item);
+        command->item = nullptr;
+        break;
+
+    case UndoCommand::Group:
+        // Commands refer to the tree as it was after the change they undo,
+        // so they are applied from the last. Inverses are appended, so the
+        // inverse group is applied in the original order.
+        for (int i = command->commands.size() - 1; i >= 0; --i) {
+            inverse->commands.append(apply(command->commands.at(i)));
+        }
+        command->commands.clear();
+        break;
+    }
+
+    delete command;
+    return inverse;
+}
@@ -48,7 +48,10 @@ public:
     ~BencodeModel();
 
     void setJson(const QVariant &json);
+    // Parses JSON text directly. Model is not changed on error.
+    bool setJson(const QByteArray &json, QString *errorString = nullptr, int *errorOffset = nullptr);
     QVariant toJson() const;
+    bool toJson(QIODevice *device, Bencode::JsonFormat format = Bencode::JsonFormat::Indented, Bencode::BlobEncoding blobEncoding = Bencode::BlobEncoding::Escaped) const;
 
     void setRaw(const QByteArray &raw);
     QByteArray toRaw() const;
@@ -57,6 +60,22 @@ public:
     void resetModified();
     bool isModified() const;
 
+    // Undo history. Commands keep only changed items, so undo and redo
+    // cost as much as the change itself. History is limited by steps and
+    // by memory, the oldest steps are dropped first.
+    bool canUndo() const;
+    bool canRedo() const;
+    void clearUndo();
+    // 0 disables undo, no commands are recorded
+    void setUndoLimit(int limit);
+    int undoLimit() const;
+    void setUndoMemoryLimit(qint64 bytes);
+    qint64 undoMemoryLimit() const;
+
+    // All changes between begin and end are undone as one step
+    void beginUndoGroup();
+    void endUndoGroup();
+
     void setTextCodec(QTextCodec *textCodec);
     QTextCodec *textCodec() const;
 
@@ -113,13 +132,55 @@ public:
     bool removeRows(int row, int count, const QModelIndex &parent = QModelIndex()) override;
     Qt::ItemFlags flags(const QModelIndex &index) const override;
 
+public slots:
+    void undo();
+    void redo();
+
 private:
+    struct UndoCommand;
+
     QString toUnicode(const QByteArray &encoded) const;
     QByteArray fromUnicode(const QString &unicode) const;
 
+    void setBencode(Bencode *newBencode);
+    Bencode *replaceBencode(Bencode *bencode);
+    int changeKey(const QModelIndex &index, const QByteArray &key);
+
+    QList<int> nodeToPath(Bencode *node) const;
+    Bencode *pathToNode(const QList<int> &path) const;
+
+    // Tree changes of the setters. Every change is recorded for undo.
+    Bencode *mapItem(Bencode *parentItem, Bencode::Type type, const QByteArray &key);
+    void insertItem(Bencode *parentItem, int row, Bencode *item);
+    void insertMapItem(Bencode *parentItem, Bencode *item);
+    void removeItem(Bencode *item);
+    void removeTopItem(const QByteArray &key);
+    // Empty info is removed too
+    void removeInfoItem(const QByteArray &key);
+    void setItemInteger(Bencode *item, qlonglong integer);
+    void setItemString(Bencode *item, const QByteArray &string);
+    void setItemHex(Bencode *item, bool hex);
+
+    // False when the undo limit is 0
+    bool isUndoEnabled() const;
+    void addUndo(UndoCommand *command);
+    void pushStack(QList<UndoCommand*> &stack, UndoCommand *command);
+    UndoCommand *takeStack(QList<UndoCommand*> &stack);
+    void trimUndo();
+    UndoCommand *apply(UndoCommand *command);
+
     // Here saved .torrent file
     Bencode *_bencode;
     Bencode *_originBencode;
 
     QTextCodec *_textCodec;
+
+    QList<UndoCommand*> _undoStack;
+    QList<UndoCommand*> _redoStack;
+    UndoCommand *_undoGroup;
+    int _undoGroupLevel;
+    int _undoLimit;
+    qint64 _undoMemoryLimit;
+    // Memory of both stacks
+    qint64 _undoBytes;
 };
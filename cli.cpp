@@ -0,0 +1,936 @@
+/*
+ * This is an open source non-commercial project. Dear PVS-Studio, please check it.
+ * PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+ *
+ * Copyright (C) 2019  Ivan Romanov <drizt72@zoho.eu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "cli.h"
+#include "batch.h"
+#include "bencode.h"
+#include "mappedfile.h"
+#include "pieceindex.h"
+#include "torrentcreator.h"
+#include "torrentrewriter.h"
+#include "torrentsummary.h"
+#include "worker.h"
+
+#include <QBuffer>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+
+#ifdef Q_OS_WIN
+# include <fcntl.h>
+# include <io.h>
+#endif
+
+namespace {
+
+// "-" is stdout
+bool openDest(QFile &file, QIODevice::OpenMode mode)
+{
+    if (file.fileName() != QLatin1String("-"))
+        return file.open(mode);
+
+#ifdef Q_OS_WIN
+    // Bencode is binary. Don't let CRT replace new lines.
+    if (!(mode & QIODevice::Text))
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    return file.open(stdout, mode);
+}
+
+bool toJson(const QString &source, const QString &dest, Bencode::BlobEncoding blobEncoding, QString *errorString)
+{
+    MappedFile sourceFile(source);
+    if (!sourceFile.open()) {
+        *errorString = QStringLiteral("can't open source file");
+        return false;
+    }
+
+    QFile destFile(dest);
+    if (!openDest(destFile, QIODevice::WriteOnly | QIODevice::Text)) {
+        *errorString = QStringLiteral("can't open destination file");
+        return false;
+    }
+
+    // JSON is written while bencode is parsed. No items are built.
+    if (!Bencode::rawToJson(sourceFile.data(), &destFile, Bencode::JsonFormat::Indented, blobEncoding)) {
+        if (dest != QLatin1String("-"))
+            destFile.remove();
+        *errorString = QStringLiteral("can't parse bencode format");
+        return false;
+    }
+
+    destFile.close();
+    return true;
+}
+
+bool fromJson(const QString &source, const QString &dest, QString *errorString)
+{
+    MappedFile sourceFile(source);
+    if (!sourceFile.open()) {
+        *errorString = QStringLiteral("can't open source file");
+        return false;
+    }
+
+    QString jsonError;
+    int errorOffset;
+    Bencode *bencode = Bencode::fromJson(sourceFile.data(), &jsonError, &errorOffset);
+    sourceFile.close();
+    if (!bencode) {
+        *errorString = QStringLiteral("can't parse json format: %1 at offset %2").arg(jsonError).arg(errorOffset);
+        return false;
+    }
+
+    QFile destFile(dest);
+    if (!openDest(destFile, QIODevice::WriteOnly)) {
+        *errorString = QStringLiteral("can't open destination file");
+        delete bencode;
+        return false;
+    }
+    destFile.write(bencode->toRaw());
+    destFile.close();
+    delete bencode;
+    return true;
+}
+
+bool parseBlobs(const QString &option, Bencode::BlobEncoding &blobEncoding)
+{
+    if (option == QLatin1String("--blobs=hex"))
+        blobEncoding = Bencode::BlobEncoding::Hex;
+    else if (option == QLatin1String("--blobs=base64"))
+        blobEncoding = Bencode::BlobEncoding::Base64;
+    else
+        return false;
+    return true;
+}
+
+QByteArray csvField(const QString &field)
+{
+    QByteArray utf8 = field.toUtf8();
+    if (!utf8.contains(',') && !utf8.contains('"') && !utf8.contains('\n') && !utf8.contains('\r'))
+        return utf8;
+
+    utf8.replace('"', "\"\"");
+    return '"' + utf8 + '"';
+}
+
+QByteArray summaryCsv(const QString &fileName, const TorrentSummary &summary)
+{
+    QByteArray res;
+    res += csvField(fileName);
+    res += ',';
+    res += summary.infoHash.toLatin1();
+    res += ',';
+    res += csvField(summary.name);
+    res += ',';
+    res += QByteArray::number(summary.totalSize);
+    res += ',';
+    res += QByteArray::number(summary.pieceSize);
+    res += ',';
+    res += QByteArray::number(summary.files.size());
+    res += ',';
+    res += summary.privateTorrent ? '1' : '0';
+    res += ',';
+    res += csvField(summary.trackers.join(QStringLiteral(" ")));
+    return res;
+}
+
+QByteArray summaryJson(const QString &fileName, const TorrentSummary &summary)
+{
+    QByteArray res("{\"file\":");
+    res += jsonString(fileName);
+    res += ",\"infohash\":\"";
+    res += summary.infoHash.toLatin1();
+    res += "\",\"name\":";
+    res += jsonString(summary.name);
+    res += ",\"totalSize\":";
+    res += QByteArray::number(summary.totalSize);
+    res += ",\"pieceSize\":";
+    res += QByteArray::number(summary.pieceSize);
+    res += ",\"files\":";
+    res += QByteArray::number(summary.files.size());
+    res += ",\"private\":";
+    res += summary.privateTorrent ? "true" : "false";
+    res += ",\"trackers\":[";
+    for (int i = 0; i < summary.trackers.size(); ++i) {
+        if (i)
+            res += ',';
+        res += jsonString(summary.trackers.at(i));
+    }
+    res += "]}";
+    return res;
+}
+
+// --summary [--format=csv|ndjson] [--jobs=N] inputs...
+int runSummary(int argc, char *argv[])
+{
+    bool csv = true;
+    int jobs = 0;
+    QStringList args;
+    for (int i = 2; i < argc; ++i) {
+        QString arg = fromArgument(argv[i]);
+        bool ok = true;
+        if (!args.isEmpty() || !arg.startsWith(QLatin1String("--"))) {
+            args << arg;
+        }
+        else if (arg == QLatin1String("--format=csv") || arg == QLatin1String("--format=ndjson")) {
+            csv = arg.endsWith(QLatin1String("csv"));
+        }
+        else if (arg.startsWith(QLatin1String("--jobs="))) {
+            jobs = arg.mid(7).toInt(&ok);
+            ok = ok && jobs >= 0;
+        }
+        else {
+            ok = false;
+        }
+
+        if (!ok) {
+            qDebug("Error: wrong option %s", argv[i]);
+            return -1;
+        }
+    }
+
+    QList<Batch::Input> inputs;
+    QString errorString;
+    if (args.isEmpty() || !Batch::collectInputs(args, QStringList(QStringLiteral("*.torrent")), inputs, &errorString)) {
+        qDebug("Error: %s", args.isEmpty() ? "no inputs" : qPrintable(errorString));
+        return -1;
+    }
+
+    QFile out;
+    if (!out.open(stdout, QIODevice::WriteOnly)) {
+        qDebug("Error: can't open stdout");
+        return -1;
+    }
+
+    if (csv) {
+        out.write("file,infohash,name,total_size,piece_size,files,private,trackers\n");
+        out.flush();
+    }
+
+    // Lines are in order of completion
+    QMutex outMutex;
+    Batch batch(jobs);
+    batch.run(inputs, [&](const Batch::Input &input, QString *error) {
+        MappedFile file(input.path);
+        if (!file.open()) {
+            *error = QStringLiteral("can't open file");
+            return false;
+        }
+
+        TorrentSummary summary;
+        if (!TorrentSummary::fromRaw(file.data(), summary, error))
+            return false;
+
+        QByteArray line = csv ? summaryCsv(input.path, summary) : summaryJson(input.path, summary);
+        line += '\n';
+
+        QMutexLocker locker(&outMutex);
+        out.write(line);
+        return true;
+    });
+    out.flush();
+
+    batch.printSummary();
+    return batch.failed() ? -1 : 0;
+}
+
+QByteArray jsonPaths(const QList<PieceIndex::Torrent> &torrents, const QList<int> &group)
+{
+    QByteArray res = "[";
+    for (int i: group) {
+        if (res.size() > 1)
+            res += ',';
+        res += jsonString(torrents.at(i).path);
+    }
+    res += ']';
+    return res;
+}
+
+// Identical info hashes, identical pieces and partial overlaps as JSON lines
+int runDuplicates(int argc, char *argv[])
+{
+    int minShared = 1;
+    int jobs = 0;
+    QStringList args;
+    for (int i = 2; i < argc; ++i) {
+        QString arg = fromArgument(argv[i]);
+        bool ok = true;
+        if (!args.isEmpty() || !arg.startsWith(QLatin1String("--"))) {
+            args << arg;
+        }
+        else if (arg.startsWith(QLatin1String("--min-shared="))) {
+            minShared = arg.mid(13).toInt(&ok);
+            ok = ok && minShared > 0;
+        }
+        else if (arg.startsWith(QLatin1String("--jobs="))) {
+            jobs = arg.mid(7).toInt(&ok);
+            ok = ok && jobs >= 0;
+        }
+        else {
+            ok = false;
+        }
+
+        if (!ok) {
+            qDebug("Error: wrong option %s", argv[i]);
+            return -1;
+        }
+    }
+
+    QList<Batch::Input> inputs;
+    QString errorString;
+    if (args.isEmpty() || !Batch::collectInputs(args, QStringList(QStringLiteral("*.torrent")), inputs, &errorString)) {
+        qDebug("Error: %s", args.isEmpty() ? "no inputs" : qPrintable(errorString));
+        return -1;
+    }
+
+    Batch batch(jobs);
+    PieceIndex index;
+    index.build(inputs, batch);
+    batch.printSummary();
+
+    QFile out;
+    if (!out.open(stdout, QIODevice::WriteOnly)) {
+        qDebug("Error: can't open stdout");
+        return -1;
+    }
+
+    const QList<PieceIndex::Torrent> &torrents = index.torrents();
+    for (const QList<int> &group: index.sameInfoHash()) {
+        out.write("{\"type\":\"infohash\",\"infohash\":\"" + torrents.at(group.first()).infoHash.toHex()
+                  + "\",\"files\":" + jsonPaths(torrents, group) + "}\n");
+    }
+
+    for (const QList<int> &group: index.samePieces()) {
+        out.write("{\"type\":\"pieces\",\"pieces\":" + QByteArray::number(torrents.at(group.first()).pieceCount)
+                  + ",\"files\":" + jsonPaths(torrents, group) + "}\n");
+    }
+
+    for (const PieceIndex::Overlap &overlap: index.overlaps(minShared)) {
+        const PieceIndex::Torrent &first = torrents.at(overlap.first);
+        const PieceIndex::Torrent &second = torrents.at(overlap.second);
+        out.write("{\"type\":\"overlap\",\"shared\":" + QByteArray::number(overlap.shared)
+                  + ",\"first\":{\"file\":" + jsonString(first.path)
+                  + ",\"pieces\":" + QByteArray::number(first.pieceCount)
+                  + ",\"offset\":" + QByteArray::number(overlap.firstPiece)
+                  + "},\"second\":{\"file\":" + jsonString(second.path)
+                  + ",\"pieces\":" + QByteArray::number(second.pieceCount)
+                  + ",\"offset\":" + QByteArray::number(overlap.secondPiece)
+                  + "}}\n");
+    }
+    out.flush();
+
+    return batch.failed() ? -1 : 0;
+}
+
+// --create [options] path dest
+int runCreate(int argc, char *argv[])
+{
+    if (argc < 4) // -V112 PVS-Studio
+        return -1;
+
+    TorrentCreator creator;
+    QStringList trackers;
+    for (int i = 2; i < argc - 2; ++i) {
+        QString arg = fromArgument(argv[i]);
+        bool ok = true;
+        if (arg == QLatin1String("--private")) {
+            creator.setPrivateTorrent(true);
+        }
+        else if (arg.startsWith(QLatin1String("--piece-size="))) {
+            // In KiB. One of the sizes offered by the GUI, 32 KiB to 32 MiB.
+            QString value = arg.mid(13);
+            qulonglong pieceSize = value == QLatin1String("auto") ? 0 : value.toULongLong(&ok) * 1024;
+            ok = ok && (!pieceSize || Worker::pieceSizes().contains(pieceSize));
+            creator.setPieceSize(pieceSize);
+        }
+        else if (arg.startsWith(QLatin1String("--tracker="))) {
+            trackers << arg.mid(10);
+        }
+        else if (arg.startsWith(QLatin1String("--comment="))) {
+            creator.setComment(arg.mid(10));
+        }
+        else if (arg.startsWith(QLatin1String("--created-by="))) {
+            creator.setCreatedBy(arg.mid(13));
+        }
+        else if (arg.startsWith(QLatin1String("--jobs="))) {
+            int jobs = arg.mid(7).toInt(&ok);
+            ok = ok && jobs >= 0;
+            creator.setThreadCount(jobs);
+        }
+        else {
+            ok = false;
+        }
+
+        if (!ok) {
+            qDebug("Error: wrong option %s", argv[i]);
+            return -1;
+        }
+    }
+    creator.setTrackers(trackers);
+
+    QString source = fromArgument(argv[argc - 2]);
+    QString dest = fromArgument(argv[argc - 1]);
+
+    // One JSON object per line
+    creator.setProgressFunction([](qint64 done, qint64 total) {
+        printf("{\"event\":\"progress\",\"done\":%lld,\"total\":%lld}\n", done, total);
+        fflush(stdout);
+    });
+
+    creator.setPath(source);
+    QString errorString;
+    QByteArray raw = creator.create(&errorString);
+    if (raw.isEmpty()) {
+        qDebug("Error: %s", qPrintable(errorString));
+        return -1;
+    }
+
+    QFile destFile(dest);
+    if (!destFile.open(QIODevice::WriteOnly) || destFile.write(raw) != raw.size()) {
+        qDebug("Error: can't write destination file");
+        return -1;
+    }
+    destFile.close();
+
+    printf("{\"event\":\"done\",\"infohash\":\"%s\",\"pieceSize\":%llu,\"totalSize\":%lld,\"output\":%s}\n",
+           qPrintable(creator.hash()), creator.pieceSize(), creator.totalSize(), jsonString(dest).constData());
+    return 0;
+}
+
+// --rewrite [edits] inputs...
+int runRewrite(int argc, char *argv[])
+{
+    TorrentRewriter rewriter;
+    QStringList trackers;
+    QStringList urls;
+    bool clearTrackers = false;
+    bool clearUrls = false;
+    bool dryRun = false;
+    int jobs = 0;
+    QStringList args;
+    for (int i = 2; i < argc; ++i) {
+        QString arg = fromArgument(argv[i]);
+        bool ok = true;
+        if (!args.isEmpty() || !arg.startsWith(QLatin1String("--")))
+            args << arg;
+        else if (arg.startsWith(QLatin1String("--tracker=")))
+            trackers << arg.mid(10);
+        else if (arg == QLatin1String("--clear-trackers"))
+            clearTrackers = true;
+        else if (arg.startsWith(QLatin1String("--url-list=")))
+            urls << arg.mid(11);
+        else if (arg == QLatin1String("--clear-url-list"))
+            clearUrls = true;
+        else if (arg == QLatin1String("--private=1") || arg == QLatin1String("--private=0"))
+            rewriter.setPrivateTorrent(arg.endsWith(QLatin1Char('1')));
+        else if (arg.startsWith(QLatin1String("--comment=")))
+            rewriter.setComment(arg.mid(10));
+        else if (arg.startsWith(QLatin1String("--created-by=")))
+            rewriter.setCreatedBy(arg.mid(13));
+        else if (arg == QLatin1String("--dry-run"))
+            dryRun = true;
+        else if (arg.startsWith(QLatin1String("--jobs="))) {
+            jobs = arg.mid(7).toInt(&ok);
+            ok = ok && jobs >= 0;
+        }
+        else
+            ok = false;
+
+        if (!ok) {
+            qDebug("Error: wrong option %s", argv[i]);
+            return -1;
+        }
+    }
+
+    if (clearTrackers || !trackers.isEmpty())
+        rewriter.setTrackers(trackers);
+    if (clearUrls || !urls.isEmpty())
+        rewriter.setUrlList(urls);
+
+    if (!rewriter.hasEdits() || args.isEmpty()) {
+        qDebug("Error: no edits or inputs");
+        return -1;
+    }
+
+    QList<Batch::Input> inputs;
+    QString errorString;
+    if (!Batch::collectInputs(args, QStringList(QStringLiteral("*.torrent")), inputs, &errorString)) {
+        qDebug("Error: %s", qPrintable(errorString));
+        return -1;
+    }
+
+    QFile out;
+    if (!out.open(stdout, QIODevice::WriteOnly)) {
+        qDebug("Error: can't open stdout");
+        return -1;
+    }
+
+    // Lines are in order of completion
+    QMutex outMutex;
+    Batch batch(jobs);
+    batch.run(inputs, [&](const Batch::Input &input, QString *error) {
+        MappedFile file(input.path);
+        if (!file.open()) {
+            *error = QStringLiteral("can't open file");
+            return false;
+        }
+
+        QByteArray result;
+        if (!rewriter.rewrite(file.data(), result, error))
+            return false;
+
+        QString oldHash = TorrentRewriter::infoHash(file.data());
+        bool changed = result != file.data();
+        // Mapping must be closed before the file is replaced
+        file.close();
+
+        if (changed && !dryRun && !TorrentRewriter::writeFile(input.path, result, error))
+            return false;
+
+        QByteArray line = "{\"file\":" + jsonString(input.path);
+        line += ",\"oldInfohash\":\"" + oldHash.toLatin1();
+        line += "\",\"newInfohash\":\"" + TorrentRewriter::infoHash(result).toLatin1();
+        line += "\",\"changed\":";
+        line += changed ? "true}\n" : "false}\n";
+
+        QMutexLocker locker(&outMutex);
+        out.write(line);
+        return true;
+    });
+    out.flush();
+
+    batch.printSummary();
+    return batch.failed() ? -1 : 0;
+}
+
+// Writes torrents from stdin one after another. Input is read by chunks,
+// so a stream of concatenated torrents doesn't need to fit in memory.
+// Broken torrents are reported and skipped, the following ones are still written.
+bool streamNdjson(QFile &out, Bencode::BlobEncoding blobEncoding, QString *errorString)
+{
+    // Bigger incomplete data is treated as broken, so memory stays bounded
+    const int MaxTorrentSize = 256 * 1024 * 1024;
+
+#ifdef Q_OS_WIN
+    _setmode(_fileno(stdin), _O_BINARY);
+#endif
+
+    QFile in;
+    if (!in.open(stdin, QIODevice::ReadOnly)) {
+        *errorString = QStringLiteral("can't open stdin");
+        return false;
+    }
+
+    QByteArray buffer;
+    // Position of buffer in stdin for messages
+    qint64 offset = 0;
+    bool atEnd = false;
+    bool resync = false;
+    int failed = 0;
+    for (;;) {
+        int start = 0;
+        while (start < buffer.size() && isspace(static_cast<uchar>(buffer.at(start))))
+            start++;
+        buffer.remove(0, start);
+        offset += start;
+
+        if (!buffer.isEmpty()) {
+            int end = 0;
+            Bencode::ScanResult result = buffer.at(0) == 'd' ? Bencode::scanItem(buffer, 0, &end) : Bencode::ScanResult::Invalid;
+            if (result == Bencode::ScanResult::Incomplete && (atEnd || buffer.size() > MaxTorrentSize))
+                result = Bencode::ScanResult::Invalid;
+
+            if (result == Bencode::ScanResult::Complete) {
+                QBuffer line;
+                line.open(QIODevice::WriteOnly);
+                if (Bencode::rawToJson(QByteArray::fromRawData(buffer.constData(), end), &line, Bencode::JsonFormat::Compact, blobEncoding)) {
+                    line.write("\n");
+                    out.write(line.data());
+                    out.flush();
+                }
+                else {
+                    qDebug("Error: stdin: can't parse bencode format at byte %lld", offset);
+                    failed++;
+                }
+
+                resync = false;
+                buffer.remove(0, end);
+                offset += end;
+                continue;
+            }
+
+            if (result == Bencode::ScanResult::Invalid) {
+                if (!resync) {
+                    qDebug("Error: stdin: can't parse bencode format at byte %lld", offset);
+                    failed++;
+                    resync = true;
+                }
+
+                // Skip to the next dictionary with a string key, it may start a torrent
+                int next = buffer.indexOf('d', 1);
+                while (next != -1 && next + 1 < buffer.size() && !isdigit(static_cast<uchar>(buffer.at(next + 1))))
+                    next = buffer.indexOf('d', next + 1);
+                if (next == -1)
+                    next = buffer.size();
+
+                buffer.remove(0, next);
+                offset += next;
+                continue;
+            }
+        }
+
+        if (atEnd)
+            break;
+
+        // Incomplete torrent is scanned again after the read.
+        // Reading as much as is buffered keeps big torrents linear.
+        QByteArray chunk = in.read(qMax(64 * 1024, buffer.size()));
+        atEnd = chunk.isEmpty();
+        buffer += chunk;
+    }
+
+    if (failed) {
+        *errorString = QStringLiteral("%1 broken torrents in stdin were skipped").arg(failed);
+        return false;
+    }
+    return true;
+}
+
+// --ndjson [options] inputs... One compact JSON object per torrent.
+int runNdjson(int argc, char *argv[])
+{
+    Bencode::BlobEncoding blobEncoding = Bencode::BlobEncoding::Escaped;
+    int jobs = 0;
+    bool readStdin = false;
+    QStringList args;
+    for (int i = 2; i < argc; ++i) {
+        QString arg = fromArgument(argv[i]);
+        bool ok = true;
+        if (arg == QLatin1String("-")) {
+            readStdin = true;
+        }
+        else if (!args.isEmpty() || !arg.startsWith(QLatin1String("--"))) {
+            args << arg;
+        }
+        else if (arg.startsWith(QLatin1String("--jobs="))) {
+            jobs = arg.mid(7).toInt(&ok);
+            ok = ok && jobs >= 0;
+        }
+        else {
+            ok = parseBlobs(arg, blobEncoding);
+        }
+
+        if (!ok) {
+            qDebug("Error: wrong option %s", argv[i]);
+            return -1;
+        }
+    }
+
+    // No inputs means stdin like other filters
+    if (args.isEmpty())
+        readStdin = true;
+
+    QFile out;
+    if (!out.open(stdout, QIODevice::WriteOnly)) {
+        qDebug("Error: can't open stdout");
+        return -1;
+    }
+
+    QString errorString;
+    if (readStdin && !streamNdjson(out, blobEncoding, &errorString)) {
+        qDebug("Error: %s", qPrintable(errorString));
+        return -1;
+    }
+
+    if (args.isEmpty())
+        return 0;
+
+    QList<Batch::Input> inputs;
+    if (!Batch::collectInputs(args, QStringList() << QStringLiteral("*.torrent") << QStringLiteral("*.dat"), inputs, &errorString)) {
+        qDebug("Error: %s", qPrintable(errorString));
+        return -1;
+    }
+
+    // Lines are converted in parallel. Order of lines is the order of completion.
+    QMutex outMutex;
+    Batch batch(jobs);
+    batch.run(inputs, [&](const Batch::Input &input, QString *error) {
+        MappedFile file(input.path);
+        if (!file.open()) {
+            *error = QStringLiteral("can't open file");
+            return false;
+        }
+
+        QBuffer line;
+        line.open(QIODevice::WriteOnly);
+        if (!Bencode::rawToJson(file.data(), &line, Bencode::JsonFormat::Compact, blobEncoding)) {
+            *error = QStringLiteral("can't parse bencode format");
+            return false;
+        }
+        line.write("\n");
+
+        QMutexLocker locker(&outMutex);
+        out.write(line.data());
+        out.flush();
+        return true;
+    });
+
+    batch.printSummary();
+    return batch.failed() ? -1 : 0;
+}
+
+// --batch --to-json|--from-json [options] inputs...
+int runBatch(int argc, char *argv[])
+{
+    if (argc < 4) // -V112 PVS-Studio
+        return -1;
+
+    QString command = QString::fromUtf8(argv[2]);
+    bool isToJson = command == QLatin1String("--to-json");
+    if (!isToJson && command != QLatin1String("--from-json")) {
+        qDebug("Error: unknown batch command %s", argv[2]);
+        return -1;
+    }
+
+    Bencode::BlobEncoding blobEncoding = Bencode::BlobEncoding::Escaped;
+    QString outDir;
+    int jobs = 0;
+    QStringList args;
+    for (int i = 3; i < argc; ++i) {
+        QString arg = fromArgument(argv[i]);
+        if (!args.isEmpty() || !arg.startsWith(QLatin1String("--"))) {
+            args << arg;
+        }
+        else if (arg.startsWith(QLatin1String("--out="))) {
+            outDir = arg.mid(6);
+        }
+        else if (arg.startsWith(QLatin1String("--jobs="))) {
+            bool ok;
+            jobs = arg.mid(7).toInt(&ok);
+            if (!ok || jobs < 0) {
+                qDebug("Error: wrong jobs count %s", argv[i]);
+                return -1;
+            }
+        }
+        else if (!isToJson || !parseBlobs(arg, blobEncoding)) {
+            qDebug("Error: unknown option %s", argv[i]);
+            return -1;
+        }
+    }
+
+    QStringList nameFilters;
+    if (isToJson)
+        nameFilters << QStringLiteral("*.torrent") << QStringLiteral("*.dat");
+    else
+        nameFilters << QStringLiteral("*.json");
+
+    QList<Batch::Input> inputs;
+    QString errorString;
+    if (!Batch::collectInputs(args, nameFilters, inputs, &errorString)) {
+        qDebug("Error: %s", qPrintable(errorString));
+        return -1;
+    }
+
+    // All outputs are known before anything is written, so no two inputs
+    // are written to the same file at once
+    for (Batch::Input &input: inputs) {
+        if (isToJson) {
+            input.output = Batch::outputPath(input, outDir, QStringLiteral(".json"));
+            continue;
+        }
+
+        // file.torrent.json is converted back to file.torrent
+        Batch::Input dest = input;
+        if (dest.path.endsWith(QLatin1String(".json"), Qt::CaseInsensitive)) {
+            dest.path.chop(5);
+            dest.relativePath.chop(5);
+        }
+        QString suffix = QFileInfo(dest.path).suffix().isEmpty() ? QStringLiteral(".torrent") : QString();
+        input.output = Batch::outputPath(dest, outDir, suffix);
+    }
+
+    if (!Batch::checkOutputs(inputs, &errorString)) {
+        qDebug("Error: %s", qPrintable(errorString));
+        return -1;
+    }
+
+    Batch batch(jobs);
+    batch.run(inputs, [&](const Batch::Input &input, QString *error) {
+        if (!outDir.isEmpty())
+            QDir().mkpath(QFileInfo(input.output).path());
+
+        if (isToJson)
+            return toJson(input.path, input.output, blobEncoding, error);
+        return fromJson(input.path, input.output, error);
+    });
+
+    batch.printSummary();
+    return batch.failed() ? -1 : 0;
+}
+
+} // namespace
+
+QString fromArgument(const char *arg)
+{
+#ifndef Q_OS_WIN
+    return QString::fromUtf8(arg);
+#else
+    return QString::fromLocal8Bit(arg);
+#endif
+}
+
+QByteArray jsonString(const QString &string)
+{
+    QByteArray utf8 = string.toUtf8();
+    QByteArray res;
+    res.reserve(utf8.size() + 2);
+    res += '"';
+    for (char c: utf8) {
+        uchar u = static_cast<uchar>(c);
+        if (c == '"' || c == '\\') {
+            res += '\\';
+            res += c;
+        }
+        else if (u < 0x20) {
+            res += "\\u00";
+            res += QByteArray::number(u, 16).rightJustified(2, '0');
+        }
+        else {
+            res += c;
+        }
+    }
+    res += '"';
+    return res;
+}
+
+bool isCliCommand(int argc, char *argv[])
+{
+    if (argc >= 2 && (!strcmp(argv[1], "--batch") || !strcmp(argv[1], "--create") || !strcmp(argv[1], "--rewrite") || !strcmp(argv[1], "--ndjson") || !strcmp(argv[1], "--summary") || !strcmp(argv[1], "--duplicates")))
+        return true;
+
+    if (argc != 4 && argc != 5) // -V112 PVS-Studio
+        return false;
+
+    return !strcmp(argv[1], "--to-json") || !strcmp(argv[1], "--from-json");
+}
+
+int runCli(int argc, char *argv[])
+{
+    if (!isCliCommand(argc, argv))
+        return -1;
+
+    if (!strcmp(argv[1], "--batch"))
+        return runBatch(argc, argv);
+
+    if (!strcmp(argv[1], "--create"))
+        return runCreate(argc, argv);
+
+    if (!strcmp(argv[1], "--rewrite"))
+        return runRewrite(argc, argv);
+
+    if (!strcmp(argv[1], "--ndjson"))
+        return runNdjson(argc, argv);
+
+    if (!strcmp(argv[1], "--summary"))
+        return runSummary(argc, argv);
+
+    if (!strcmp(argv[1], "--duplicates"))
+        return runDuplicates(argc, argv);
+
+    QString command = QString::fromUtf8(argv[1]);
+
+    // Optional binary strings encoding for --to-json
+    Bencode::BlobEncoding blobEncoding = Bencode::BlobEncoding::Escaped;
+    if (argc == 5) {
+        QString option = QString::fromUtf8(argv[2]);
+        if (command != QLatin1String("--to-json") || !parseBlobs(option, blobEncoding)) {
+            qDebug("Error: unknown option %s", argv[2]);
+            return -1;
+        }
+    }
+
+    QString source = fromArgument(argv[argc - 2]);
+    QString dest = fromArgument(argv[argc - 1]);
+
+    if (source != QLatin1String("-") && !QFile::exists(source)) {
+        qDebug("Error: source file is not exist!");
+        return -1;
+    }
+
+    QString errorString;
+    bool ok = command == QLatin1String("--to-json")
+            ? toJson(source, dest, blobEncoding, &errorString)
+            : fromJson(source, dest, &errorString);
+    if (!ok)
+        qDebug("Error: %s", qPrintable(errorString));
+    return ok ? 0 : -1;
+}
+
+void printCliUsage(const char *program)
+{
+    printf("Usage: %s --to-json [--blobs=hex|base64] | --from-json  source dest\n"
+           "Source and dest may be - for stdin and stdout.\n"
+           "       %s --batch --to-json|--from-json [options] inputs...\n"
+           "Inputs are files, folders, wildcards or @list files with one path per line.\n"
+           "Batch options:\n"
+           "  --blobs=hex|base64  binary strings encoding for --to-json\n"
+           "  --jobs=N            threads, all cores by default\n"
+           "  --out=folder        write results under folder instead of next to inputs\n"
+           "       %s --create [options] path dest\n"
+           "Progress and result are printed as JSON objects, one per line.\n"
+           "Create options:\n"
+           "  --piece-size=N|auto piece size in KiB, auto by default\n"
+           "  --tracker=url       may be repeated, each tracker is a tier\n"
+           "  --private\n"
+           "  --comment=text\n"
+           "  --created-by=text\n"
+           "  --jobs=N            hashing threads, all cores by default\n"
+           "       %s --rewrite [edits] inputs...\n"
+           "Files are replaced atomically. Old and new info hashes are printed as JSON lines.\n"
+           "Rewrite edits:\n"
+           "  --tracker=url       replaces trackers, may be repeated\n"
+           "  --clear-trackers\n"
+           "  --private=1|0\n"
+           "  --comment=text      empty text removes comment\n"
+           "  --created-by=text   empty text removes created by\n"
+           "  --url-list=url      replaces web seeds, may be repeated\n"
+           "  --clear-url-list\n"
+           "  --dry-run           only report changes\n"
+           "  --jobs=N\n"
+           "       %s --ndjson [--blobs=hex|base64] [--jobs=N] [-] [inputs...]\n"
+           "Writes one compact JSON object per torrent. - or no inputs reads\n"
+           "concatenated torrents from stdin.\n"
+           "       %s --summary [--format=csv|ndjson] [--jobs=N] inputs...\n"
+           "Writes info hash, name, total size, piece size, files count, private flag\n"
+           "and trackers of every torrent. pieces are not read.\n"
+           "       %s --duplicates [--min-shared=N] [--jobs=N] inputs...\n"
+           "Prints torrents with the same info hash, the same pieces and torrents\n"
+           "sharing at least N pieces (1 by default) as JSON lines.\n",
+           program, program, program, program, program, program, program);
+}
@@ -0,0 +1,42 @@
+/*
+ * This is an open source non-commercial project. Dear PVS-Studio, please check it.
+ * PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+ *
+ * Copyright (C) 2019  Ivan Romanov <drizt72@zoho.eu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+
+// Command line modes of torrent-file-editor and tfe-cli. Depend only on QtCore.
+
+// Returns true if arguments select a command line mode
+bool isCliCommand(int argc, char *argv[]);
+
+// Runs command line mode and returns process exit code
+int runCli(int argc, char *argv[]);
+
+void printCliUsage(const char *program);
+
+// Command line argument in the system encoding
+QString fromArgument(const char *arg);
+
+// JSON string literal for machine-readable output
+QByteArray jsonString(const QString &string);
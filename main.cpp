@@ -21,9 +21,8 @@
 
 #include "mainwindow.h"
 #include "application.h"
-#include "bencode.h"
+#include "cli.h"
 
-#include <QVariant>
 #include <QFile>
 
 // Allow run Qt5 static version https://github.com/tonytheodore/mxe/commit/497669fa44356db0cd8335e2554b7bac12eb88c2
@@ -36,13 +35,6 @@ Q_IMPORT_PLUGIN(QICOPlugin)
 Q_IMPORT_PLUGIN(QJpegPlugin)
 #endif
 
-#ifdef HAVE_QT5
-# include <QJsonDocument>
-#else
-# include <qjson/serializer.h>
-# include <qjson/parser.h>
-#endif
-
 #ifdef Q_OS_WIN
 # include <windows.h>
 HANDLE hConsole = NULL;
@@ -134,89 +126,11 @@ void closeWinConsole()
 #endif
 }
 
-bool toJson(const QString &source, const QString &dest)
-{
-    QFile sourceFile(source);
-    if (!sourceFile.open(QIODevice::ReadOnly)) {
-        qDebug("Error: can't open source file");
-        return false;
-    }
-
-    QByteArray raw(sourceFile.readAll());
-    sourceFile.close();
-
-    Bencode *bencode = Bencode::fromRaw(raw);
-
-    QVariant json = bencode->toJson();
-    delete bencode;
-    if (!json.isValid()) {
-        qDebug("Error: can't parse bencode format");
-        return false;
-    }
-
-#ifdef HAVE_QT5
-    QByteArray ba = QJsonDocument::fromVariant(json).toJson();
-#else
-    QJson::Serializer serializer;
-    serializer.setIndentMode(QJson::IndentFull);
-    QByteArray ba = serializer.serialize(json);
-#endif
-
-    QFile destFile(dest);
-    if (!destFile.open(QIODevice::WriteOnly | QIODevice::Text)) {
-        qDebug("Error: can't open destination file");
-        return false;
-    }
-
-    destFile.write(ba);
-    destFile.close();
-    return true;
-}
-
-bool fromJson(const QString &source, const QString &dest)
-{
-    QFile sourceFile(source);
-    if (!sourceFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        openWinConsole();
-        qDebug("Error: can't open source file");
-        return false;
-    }
-
-    QByteArray ba(sourceFile.readAll());
-    sourceFile.close();
-
-#ifdef HAVE_QT5
-    QJsonParseError error;
-    QVariant variant = QJsonDocument::fromJson(ba, &error).toVariant();
-#else
-    QJson::Parser parser;
-    bool ok;
-    QVariant variant = parser.parse(ba, &ok);
-#endif
-
-    if (!variant.isValid()) {
-        qDebug("Error: can't parse json format");
-        return false;
-    }
-
-    Bencode *bencode = Bencode::fromJson(variant);
-
-    QFile destFile(dest);
-    if (!destFile.open(QIODevice::WriteOnly)) {
-        qDebug("Error: can't open destination file");
-        return false;
-    }
-    destFile.write(bencode->toRaw());
-    destFile.close();
-    delete bencode;
-    return true;
-}
-
 int main(int argc, char *argv[])
 {
     if (argc == 2 && !strcmp(argv[1], "--help")) {
         openWinConsole();
-        printf("Usage: torrent-file-editor --to-json | --from-json  source dest\n");
+        printCliUsage("torrent-file-editor");
         closeWinConsole();
         return 0;
     }
@@ -226,32 +140,11 @@ int main(int argc, char *argv[])
     NVWA::new_autocheck_flag = false;
 #endif
 
-    if (argc == 4) { // -V112 PVS-Studio
-        QString command = QString::fromUtf8(argv[1]);
-#ifndef Q_OS_WIN
-        QString source = QString::fromUtf8(argv[2]);
-        QString dest = QString::fromUtf8(argv[3]);
-#else
-        QString source = QString::fromLocal8Bit(argv[2]);
-        QString dest = QString::fromLocal8Bit(argv[3]);
-#endif
-
-        if (command == QLatin1String("--to-json") || command == QLatin1String("--from-json")) {
-            int retCode = 0;
-            openWinConsole();
-
-            if (!QFile::exists(source)) {
-                qDebug("Error: source file is not exist!");
-                retCode = -1;
-            }
-            else if (command == QLatin1String("--to-json"))
-                retCode = toJson(source, dest) ? -1 : 0;
-            else
-                retCode = fromJson(source, dest) ? -1 : 0;
-
-            closeWinConsole();
-            return retCode;
-        }
+    if (isCliCommand(argc, argv)) {
+        openWinConsole();
+        int retCode = runCli(argc, argv);
+        closeWinConsole();
+        return retCode;
     }
 
 #ifdef Q_OS_WIN
@@ -262,6 +155,8 @@ int main(int argc, char *argv[])
 # endif
 #endif
 
+    Application::traceStartup("main");
+
     int returnCode = 0;
     // For nvwa purposes. Need to delete local objects before leaks checking.
     {
@@ -270,6 +165,7 @@ int main(int argc, char *argv[])
     MainWindow w;
     a.setMainWindow(&w);
     w.show();
+    Application::traceStartup("window shown");
 
 #ifdef Q_OS_MAC
     CocoaInitializer initializer;
@@ -280,7 +176,7 @@ int main(int argc, char *argv[])
     if (argc == 2) {
         QString filename = QString::fromLocal8Bit(argv[1]);
         if (QFile::exists(filename))
-            w.open(filename);
+            w.openAfterPaint(filename);
     }
 
     returnCode = a.exec();
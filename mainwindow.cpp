@@ -22,10 +22,13 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 #include "aboutdlg.h"
+#include "application.h"
 #include "bencode.h"
 #include "bencodemodel.h"
 #include "bencodedelegate.h"
 #include "searchdlg.h"
+#include "mappedfile.h"
+#include "worker.h"
 
 #include <QFileDialog>
 #include <QFile>
@@ -35,7 +38,6 @@
 #include <QUrl>
 #include <QLocale>
 #include <QApplication>
-#include <qmath.h>
 #include <QStandardItemModel>
 #include <QDirIterator>
 #include <QProgressDialog>
@@ -44,129 +46,14 @@
 #include <QAbstractItemDelegate>
 #include <QPersistentModelIndex>
 #include <QInputDialog>
-#include <QCryptographicHash>
 #include <QTextDocument>
 #include <QMimeData>
-#include <QElapsedTimer>
 #include <QShortcut>
 #include <QClipboard>
 #include <QTranslator>
 #include <QLibraryInfo>
-
-#ifdef HAVE_QT5
-# include <QJsonDocument>
-#else
-# include <qjson/serializer.h>
-# include <qjson/parser.h>
-#endif
-
-#ifdef Q_OS_WIN
-# include <io.h>
-# include <windows.h>
-#endif
-
-#define PROGRESS_TIMEOUT 500 /* ms */
-
-// FIXME: workaround for symlink wrong size https://bugreports.qt.io/browse/QTBUG-24831
-
-static qint64 fileSize(const QString &path)
-{
-#ifdef Q_OS_UNIX
-    return QFileInfo(path).size();
-#else
-    QFileInfo fi(path);
-    if (!fi.isSymLink()) {
-        return fi.size();
-    }
-    else {
-        QFile file(path);
-        file.open(QFile::ReadOnly); // it must be open to get a windows file handle
-        HANDLE hFile = reinterpret_cast<HANDLE>(_get_osfhandle(file.handle()));
-        DWORD size = GetFileSize(hFile, nullptr);
-        file.close();
-        return static_cast<qint64>(size);
-    }
-#endif
-}
-
-Worker::Worker()
-    : QObject()
-    , _isCanceled(false)
-{
-}
-
-void Worker::doWork(const QStringList &files, int pieceSize)
-{
-    QByteArray pieceHashes;
-
-    QByteArray piece;
-    int piecePos = 0;
-    piece.resize(pieceSize);
-
-    QCryptographicHash hash(QCryptographicHash::Sha1);
-    qulonglong value = 0;
-
-    QElapsedTimer timer;
-    timer.start();
-
-    for (int i = 0; i < files.size(); ++i) {
-        QFile f(files[i]);
-        if (!f.open(QIODevice::ReadOnly)) {
-            QString errorString = QString(tr("Can't open %1")).arg(QDir::toNativeSeparators(files[i]));
-            emit resultReady(QByteArray(), errorString);
-            return;
-        }
-
-        int readed;
-        int j = 0;
-        while ((readed = f.read(piece.data() + piecePos, pieceSize - piecePos)) > 0) {  // -V104 PVS-Studio
-            piecePos += readed;
-            j++;
-            if (piecePos == pieceSize || ((i == files.size() - 1) && f.atEnd())) {
-                piece.resize(piecePos);
-                piecePos = 0;
-                hash.addData(piece);
-                pieceHashes += hash.result();
-                hash.reset();
-            }
-            value += readed;
-
-            // Do not send progress signal very often. It can leads to crash.
-            if (timer.hasExpired(PROGRESS_TIMEOUT)) {
-                emit progress(value / 1024);
-                timer.restart();
-            }
-
-            qApp->processEvents();
-            if (_isCanceled) {
-                emit resultReady(QByteArray(), QString());
-                f.close();
-                return;
-            }
-
-            if (f.atEnd()) {
-                break;
-            }
-        }
-
-        // Some error
-        if (readed < 0) {
-            QString errorString = QString(tr("Can't read from %1")).arg(QDir::toNativeSeparators(files[i]));
-            emit resultReady(QByteArray(), errorString);
-            f.close();
-            return;
-        }
-
-        f.close();
-    }
-
-    emit resultReady(pieceHashes, QString());
-}
-
-void Worker::cancel()
-{
-    _isCanceled = true;
-}
+#include <QBuffer>
+#include <QTimer>
 
 MainWindow *MainWindow::_instance;
 
@@ -175,11 +62,7 @@ MainWindow::MainWindow(QWidget *parent)
     , ui(new Ui::MainWindow)
     , _fileName(QString())
     , _bencodeModel(new BencodeModel(this))
-#ifdef Q_OS_WIN
-    , _progressDialog(new QProgressDialog(this, Qt::CustomizeWindowHint | Qt::WindowTitleHint | Qt::WindowCloseButtonHint | Qt::MSWindowsFixedSizeDialogHint))
-#else
-    , _progressDialog(new QProgressDialog(this, Qt::CustomizeWindowHint | Qt::WindowTitleHint | Qt::WindowCloseButtonHint))
-#endif
+    , _progressDialog(0)
     , _formatFilters(QStringList())
     , _lastFolder()
     , _searchDlg(0)
@@ -205,21 +88,12 @@ MainWindow::MainWindow(QWidget *parent)
     ui->btnAbout->hide();
 #endif
 
-    _progressDialog->setWindowModality(Qt::ApplicationModal);
-    _progressDialog->setLabelText(tr("Need to calculate piece hashes"));
-    _progressDialog->setWindowTitle(tr("Please wait"));
-    _progressDialog->setValue(_progressDialog->maximum());
-    _progressDialog->ensurePolished();
-    _progressDialog->adjustSize();
-    _progressDialog->setFixedSize(_progressDialog->size().width() * 2, _progressDialog->size().height());
-
     updateTitle();
 
     _instance = this;
 
     ui->cmbPieceSizes->addItem(QString(), 0);
-    for (int i = 5; i < 16; ++i) {
-        qulonglong pieceSize = 1024 * static_cast<qulonglong>(qPow(2, i));
+    for (qulonglong pieceSize: Worker::pieceSizes()) {
         ui->cmbPieceSizes->addItem(smartSize(pieceSize), pieceSize);
     }
 
@@ -267,30 +141,23 @@ MainWindow::MainWindow(QWidget *parent)
     ui->btnSave->setIcon(qApp->style()->standardIcon(QStyle::SP_DialogSaveButton));
     ui->btnSaveAs->setIcon(qApp->style()->standardIcon(QStyle::SP_DialogSaveButton));
 
-    ui->btnRemoveFiles->setIcon(QIcon::fromTheme(QStringLiteral("list-remove")));
-
-    ui->btnMakeTorrent->setIcon(QIcon(QStringLiteral(":/icons/hammer.png")));
-    ui->btnAddFile->setIcon(QIcon::fromTheme(QStringLiteral("document-new")));
-    ui->btnAddFolder->setIcon(QIcon::fromTheme(QStringLiteral("folder-new")));
-    ui->btnReloadFiles->setIcon(QIcon::fromTheme(QStringLiteral("view-refresh")));
-    ui->btnUpFile->setIcon(qApp->style()->standardIcon(QStyle::SP_ArrowUp));
-    ui->btnDownFile->setIcon(qApp->style()->standardIcon(QStyle::SP_ArrowDown));
-    ui->btnFilesFilter->setIcon(QIcon(QStringLiteral(":/icons/files-filter.png")));
-
     ui->btnAbout->setIcon(qApp->style()->standardIcon(QStyle::SP_MessageBoxQuestion));
 
-    ui->btnAddTreeItem->setIcon(QIcon::fromTheme(QStringLiteral("list-add")));
-    ui->btnRemoveTreeItem->setIcon(QIcon::fromTheme(QStringLiteral("edit-delete")));
-    ui->btnUpTreeItem->setIcon(qApp->style()->standardIcon(QStyle::SP_ArrowUp));
-    ui->btnDownTreeItem->setIcon(qApp->style()->standardIcon(QStyle::SP_ArrowDown));
-    ui->btnFindTreeItem->setIcon(QIcon::fromTheme(QStringLiteral("edit-find")));
-    ui->btnReplaceTreeItem->setIcon(QIcon::fromTheme(QStringLiteral("edit-find-replace")));
-
     new QShortcut(QKeySequence(Qt::ControlModifier | Qt::Key_G), this, SLOT(copyMagnetLink()));
     new QShortcut(QKeySequence(Qt::ControlModifier | Qt::ShiftModifier | Qt::Key_T), this, SLOT(copyMagnetExtra()));
 
-    fillCoding();
-    updateFilesSize();
+    // Undo works only for tree. Text editors have own undo.
+    QShortcut *undoShortcut = new QShortcut(QKeySequence::Undo, ui->treeJson);
+    undoShortcut->setContext(Qt::WidgetWithChildrenShortcut);
+    connect(undoShortcut, SIGNAL(activated()), _bencodeModel, SLOT(undo()));
+
+    QShortcut *redoShortcut = new QShortcut(QKeySequence::Redo, ui->treeJson);
+    redoShortcut->setContext(Qt::WidgetWithChildrenShortcut);
+    connect(redoShortcut, SIGNAL(activated()), _bencodeModel, SLOT(redo()));
+
+    // Codecs are enumerated on first use. Until then the model default is shown.
+    ui->cmbCoding->addItem(QStringLiteral("UTF-8"));
+    ui->cmbCoding->installEventFilter(this);
 
     connect(_bencodeModel, SIGNAL(dataChanged(const QModelIndex&, const QModelIndex&)), SLOT(updateTitle()));
     connect(_bencodeModel, SIGNAL(rowsMoved(const QModelIndex&, int, int, const QModelIndex&, int)), SLOT(updateTitle()));
@@ -303,6 +170,8 @@ MainWindow::MainWindow(QWidget *parent)
     _showTranslations = new QShortcut(QKeySequence(Qt::CTRL + Qt::Key_T), this, SLOT(showTranslations()));
 
     changeTranslation(-1);
+
+    Application::traceStartup("main window created");
 }
 
 MainWindow::~MainWindow()
@@ -316,6 +185,51 @@ MainWindow *MainWindow::instance()
     return _instance;
 }
 
+void MainWindow::openAfterPaint(const QString &fileName)
+{
+    if (_deferredInitDone)
+        open(fileName);
+    else
+        _pendingFileName = fileName;
+}
+
+void MainWindow::deferredInit()
+{
+    if (_deferredInitDone)
+        return;
+
+    _deferredInitDone = true;
+
+    // Files and tree tabs are hidden at startup
+    ui->btnRemoveFiles->setIcon(QIcon::fromTheme(QStringLiteral("list-remove")));
+
+    ui->btnMakeTorrent->setIcon(QIcon(QStringLiteral(":/icons/hammer.png")));
+    ui->btnAddFile->setIcon(QIcon::fromTheme(QStringLiteral("document-new")));
+    ui->btnAddFolder->setIcon(QIcon::fromTheme(QStringLiteral("folder-new")));
+    ui->btnReloadFiles->setIcon(QIcon::fromTheme(QStringLiteral("view-refresh")));
+    ui->btnUpFile->setIcon(qApp->style()->standardIcon(QStyle::SP_ArrowUp));
+    ui->btnDownFile->setIcon(qApp->style()->standardIcon(QStyle::SP_ArrowDown));
+    ui->btnFilesFilter->setIcon(QIcon(QStringLiteral(":/icons/files-filter.png")));
+
+    ui->btnAddTreeItem->setIcon(QIcon::fromTheme(QStringLiteral("list-add")));
+    ui->btnRemoveTreeItem->setIcon(QIcon::fromTheme(QStringLiteral("edit-delete")));
+    ui->btnUpTreeItem->setIcon(qApp->style()->standardIcon(QStyle::SP_ArrowUp));
+    ui->btnDownTreeItem->setIcon(qApp->style()->standardIcon(QStyle::SP_ArrowDown));
+    ui->btnFindTreeItem->setIcon(QIcon::fromTheme(QStringLiteral("edit-find")));
+    ui->btnReplaceTreeItem->setIcon(QIcon::fromTheme(QStringLiteral("edit-find-replace")));
+
+    updateFilesSize();
+
+    Application::traceStartup("deferred init done");
+
+    if (!_pendingFileName.isEmpty()) {
+        QString fileName = _pendingFileName;
+        _pendingFileName.clear();
+        open(fileName);
+        Application::traceStartup("file opened");
+    }
+}
+
 void MainWindow::showTranslations()
 {
     _showTranslations->setEnabled(false);
@@ -381,6 +295,7 @@ void MainWindow::create()
 
     _bencodeModel->setRaw("");
     _bencodeModel->resetModified();
+    _bencodeModel->clearUndo();
     _fileName = QString(); // -V815 PVS-Studio
     updateTitle();
     updateTab(ui->tabWidget->currentIndex());
@@ -396,19 +311,21 @@ void MainWindow::create()
 
 void MainWindow::open(const QString &fileName)
 {
-    QFile file(fileName);
-    if (!file.open(QIODevice::ReadOnly)) {
+    MappedFile file(fileName);
+    if (!file.open()) {
         QMessageBox::warning(this, tr("Error"), tr("Can't open file"));
         return;
     }
 
     _fileName = fileName;
 
-    _bencodeModel->setRaw(file.readAll());
+    // Parsed directly from the file mapping
+    _bencodeModel->setRaw(file.data());
     file.close();
 
     updateTab(ui->tabWidget->currentIndex());
     _bencodeModel->resetModified();
+    _bencodeModel->clearUndo();
     updateTitle();
 
     QStandardItemModel *model = qobject_cast<QStandardItemModel*>(ui->viewFiles->model());
@@ -544,9 +461,45 @@ void MainWindow::changeEvent(QEvent *event)
     QMainWindow::changeEvent(event);
 }
 
+void MainWindow::paintEvent(QPaintEvent *event)
+{
+    QMainWindow::paintEvent(event);
+
+    if (!_painted) {
+        _painted = true;
+        Application::traceStartup("first paint");
+        QTimer::singleShot(0, this, SLOT(deferredInit()));
+    }
+}
+
+bool MainWindow::eventFilter(QObject *watched, QEvent *event)
+{
+    if (watched == ui->cmbCoding) {
+        switch (event->type()) {
+        case QEvent::FocusIn:
+        case QEvent::MouseButtonPress:
+        case QEvent::KeyPress:
+        case QEvent::Wheel:
+            fillCoding();
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    return QMainWindow::eventFilter(watched, event);
+}
+
 // Token from qmmp
 void MainWindow::fillCoding()
 {
+    if (_codingFilled)
+        return;
+
+    _codingFilled = true;
+    ui->cmbCoding->removeEventFilter(this);
+
     QMap<QString, QTextCodec*> codecMap;
     QRegExp iso8859RegExp(QStringLiteral("ISO[- ]8859-([0-9]+).*"));
 
@@ -578,9 +531,35 @@ void MainWindow::fillCoding()
         codecMap.insert(sortKey, codec);
     }
 
+    // Keep current codec selected. Model is already using it.
+    QString current = ui->cmbCoding->currentText();
+    ui->cmbCoding->blockSignals(true);
+    ui->cmbCoding->clear();
     foreach (QTextCodec *textCodec, codecMap.values()) {
         ui->cmbCoding->addItem(QString::fromUtf8(textCodec->name()));
     }
+    ui->cmbCoding->setCurrentIndex(qMax(0, ui->cmbCoding->findText(current)));
+    ui->cmbCoding->blockSignals(false);
+}
+
+QProgressDialog *MainWindow::progressDialog()
+{
+    if (_progressDialog)
+        return _progressDialog;
+
+#ifdef Q_OS_WIN
+    _progressDialog = new QProgressDialog(this, Qt::CustomizeWindowHint | Qt::WindowTitleHint | Qt::WindowCloseButtonHint | Qt::MSWindowsFixedSizeDialogHint);
+#else
+    _progressDialog = new QProgressDialog(this, Qt::CustomizeWindowHint | Qt::WindowTitleHint | Qt::WindowCloseButtonHint);
+#endif
+    _progressDialog->setWindowModality(Qt::ApplicationModal);
+    _progressDialog->setLabelText(tr("Need to calculate piece hashes"));
+    _progressDialog->setWindowTitle(tr("Please wait"));
+    _progressDialog->setValue(_progressDialog->maximum());
+    _progressDialog->ensurePolished();
+    _progressDialog->adjustSize();
+    _progressDialog->setFixedSize(_progressDialog->size().width() * 2, _progressDialog->size().height());
+    return _progressDialog;
 }
 
 bool MainWindow::isModified() const
@@ -730,28 +709,30 @@ void MainWindow::makeTorrent()
 
         // Check for base folder
         files << QDir::fromNativeSeparators(file);
-        totalSize += fileSize(file);
+        totalSize += Worker::fileSize(file);
     }
 
     qulonglong pieceSize = autoPieceSize();
 
-    _progressDialog->setMaximum(totalSize / 1024);
-    _progressDialog->show();
+    QProgressDialog *dialog = progressDialog();
+    dialog->setMaximum(totalSize / 1024);
+    dialog->show();
 
     QThread *thread = new QThread;
     Worker *worker = new Worker;
     worker->moveToThread(thread);
     connect(thread, SIGNAL(finished()), worker, SLOT(deleteLater()));
     connect(this, SIGNAL(needHash(const QStringList&, int)), worker, SLOT(doWork(const QStringList&, int)));
-    connect(_progressDialog, SIGNAL(canceled()), worker, SLOT(cancel()));
+    connect(dialog, SIGNAL(canceled()), worker, SLOT(cancel()));
     connect(worker, SIGNAL(resultReady(const QByteArray&, const QString&)), this, SLOT(setPieces(const QByteArray&, const QString&)));
-    connect(worker, SIGNAL(progress(int)), _progressDialog, SLOT(setValue(int)));
+    connect(worker, SIGNAL(progress(int)), dialog, SLOT(setValue(int)));
     connect(worker, SIGNAL(resultReady(const QByteArray&, const QString&)), thread, SLOT(quit()));
     connect(thread, SIGNAL(finished()), thread, SLOT(deleteLater()));
     thread->start();
 
     emit needHash(files, pieceSize);
 
+    _bencodeModel->beginUndoGroup();
     _bencodeModel->setCreationTime(QDateTime::currentDateTime());
     _bencodeModel->setPieceSize(pieceSize);
     if (files.size() == 1) {
@@ -767,10 +748,11 @@ void MainWindow::makeTorrent()
     }
     else {
         for (const QString &file: files) {
-            filePairs << QPair<QString, qlonglong>(baseDir.relativeFilePath(file), fileSize(file));
+            filePairs << QPair<QString, qlonglong>(baseDir.relativeFilePath(file), Worker::fileSize(file));
         }
     }
     _bencodeModel->setFiles(filePairs);
+    _bencodeModel->endUndoGroup();
 }
 
 void MainWindow::addFile()
@@ -791,7 +773,7 @@ void MainWindow::addFile()
     _lastFolder = QFileInfo(files.first()).absolutePath();
     ui->leBaseFolder->setFolder(_lastFolder);
     foreach (const QString &file, files) {
-        addFilesRow(file, fileSize(file));
+        addFilesRow(file, Worker::fileSize(file));
     }
 
     if (ui->leBaseFolder->text().isEmpty()) {
@@ -825,7 +807,7 @@ void MainWindow::addFolder()
     files.sort();
 
     for (const QString &file: files) {
-        addFilesRow(file, fileSize(file));
+        addFilesRow(file, Worker::fileSize(file));
     }
 
     if (ui->leBaseFolder->text().isEmpty())
@@ -939,7 +921,7 @@ void MainWindow::updateFiles()
 
 void MainWindow::setPieces(const QByteArray &pieces, const QString &errorString)
 {
-    _progressDialog->hide();
+    progressDialog()->hide();
     _bencodeModel->setPieces(pieces);
     updateTab(ui->tabWidget->currentIndex());
     if (!errorString.isEmpty()) {
@@ -1133,47 +1115,30 @@ void MainWindow::updateBencodeFromRaw()
     }
 
     QByteArray ba = ui->pteEditor->toPlainText().toLatin1();
-#ifdef HAVE_QT5
-    QJsonParseError error;
-    QVariant variant = QJsonDocument::fromJson(ba, &error).toVariant();
-    if (error.error) {
-        int line = ba.left(error.offset).count("\n") + 1;
-        ui->lblRawError->setText(QString(tr("Error on %1 line: %2")).arg(line).arg(error.errorString()));
+    QString errorString;
+    int errorOffset;
+    if (!_bencodeModel->setJson(ba, &errorString, &errorOffset)) {
+        int line = ba.left(errorOffset).count('\n') + 1;
+        ui->lblRawError->setText(QString(tr("Error on %1 line: %2")).arg(line).arg(errorString));
         return;
     }
-#else
-    QJson::Parser parser;
-    bool ok;
-    QVariant variant = parser.parse(ba, &ok);
-    if (!ok) {
-        ui->lblRawError->setText(QString(tr("Error on %1 line: %2")).arg(parser.errorLine()).arg(parser.errorString()));
-        return;
-    }
-#endif
 
     ui->lblRawError->setText(QString());
-    _bencodeModel->setJson(variant);
 }
 
 void MainWindow::updateRaw()
 {
     // Avoid freezes
     processEvents();
-    QVariant res = _bencodeModel->toJson();
-    if (!res.isValid()) {
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    if (!_bencodeModel->toJson(&buffer)) {
         ui->pteEditor->setPlainText(QString());
         ui->pteEditor->document()->setModified(false);
         return;
     }
 
-#ifdef HAVE_QT5
-    QByteArray ba = QJsonDocument::fromVariant(res).toJson();
-#else
-    QJson::Serializer serializer;
-    serializer.setIndentMode(QJson::IndentFull);
-    QByteArray ba = serializer.serialize(res);
-#endif
-    QString newRawText = QString::fromLatin1(ba);
+    QString newRawText = QString::fromLatin1(buffer.data());
     if (newRawText != ui->pteEditor->toPlainText()) {
         ui->pteEditor->setPlainText(newRawText);
         ui->pteEditor->document()->setModified(false);
@@ -1217,15 +1182,8 @@ qulonglong MainWindow::autoPieceSize() const
     }
 
     qulonglong pieceSize = ui->cmbPieceSizes->itemData(ui->cmbPieceSizes->currentIndex()).toULongLong();
-    // http://torrentfreak.com/how-to-make-the-best-torrents-081121/
-    // Find out optimal piece size
-    if (!pieceSize) {
-        for (int i = 1; i < ui->cmbPieceSizes->count(); ++i) {
-            pieceSize = ui->cmbPieceSizes->itemData(i).toULongLong();
-            if (totalSize / pieceSize < 2000)
-                break;
-        }
-    }
+    if (!pieceSize)
+        pieceSize = Worker::autoPieceSize(totalSize);
     return pieceSize;
 }
 
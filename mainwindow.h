@@ -33,26 +33,6 @@ class SearchDlg;
 class QShortcut;
 class QTranslator;
 
-class Worker : public QObject
-{
-    Q_OBJECT
-
-public:
-    Worker();
-
-public slots:
-    void doWork(const QStringList &files, int pieceSize);
-    void cancel();
-
-signals:
-    void progress(int value);
-    void resultReady(const QByteArray &result, const QString &errorString);
-
-private:
-    bool _isCanceled;
-};
-
-
 namespace Ui { class MainWindow; }
 
 class MainWindow : public QMainWindow
@@ -67,6 +47,9 @@ public:
 
     void addLog(const QString &log);
 
+    // Opens file when startup is finished and window is painted
+    void openAfterPaint(const QString &fileName);
+
 signals:
     void needHash(const QStringList &files, int pieceSize);
 
@@ -124,12 +107,19 @@ protected:
     void dropEvent(QDropEvent *event);
     void closeEvent(QCloseEvent *event);
     void changeEvent(QEvent *event);
+    void paintEvent(QPaintEvent *event);
+    bool eventFilter(QObject *watched, QEvent *event);
+
+private slots:
+    // Things not needed for the first paint
+    void deferredInit();
 
 private:
     enum Tabs { SimpleTab, FilesTab, JsonTreeTab, RawTab, LogTab };
     enum class FilesFilters { NameFilter, ExtenstionFilter, TemplateFilter, RegExpFilter  };
 
     void fillCoding();
+    QProgressDialog *progressDialog();
 
     bool isModified() const;
 
@@ -161,6 +151,10 @@ private:
     QShortcut *_showTranslations;
     QTranslator *_translator{};
     QTranslator *_translatorQt{};
+    QString _pendingFileName;
+    bool _painted{};
+    bool _deferredInitDone{};
+    bool _codingFilled{};
 
     static MainWindow *_instance;
 };
@@ -0,0 +1,83 @@
+/*
+ * This is an open source non-commercial project. Dear PVS-Studio, please check it.
+ * PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+ *
+ * Copyright (C) 2019  Ivan Romanov <drizt72@zoho.eu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "mappedfile.h"
+
+#include <cstdio>
+#include <limits>
+
+#ifdef Q_OS_WIN
+# include <fcntl.h>
+# include <io.h>
+#endif
+
+MappedFile::MappedFile(const QString &fileName)
+    : _file(fileName)
+    , _data()
+    , _mapped(nullptr)
+{
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open()
+{
+    close();
+    bool opened;
+    if (_file.fileName() == QLatin1String("-")) {
+#ifdef Q_OS_WIN
+        _setmode(_fileno(stdin), _O_BINARY);
+#endif
+        opened = _file.open(stdin, QIODevice::ReadOnly);
+    }
+    else {
+        opened = _file.open(QIODevice::ReadOnly);
+    }
+
+    if (!opened)
+        return false;
+
+    // QByteArray size is limited by int. Empty files and pipes can't be mapped too.
+    qint64 size = _file.size();
+    if (!_file.isSequential() && size > 0 && size < std::numeric_limits<int>::max())
+        _mapped = _file.map(0, size);
+
+    if (_mapped)
+        _data = QByteArray::fromRawData(reinterpret_cast<const char*>(_mapped), static_cast<int>(size));
+    else
+        _data = _file.readAll();
+
+    return true;
+}
+
+void MappedFile::close()
+{
+    _data.clear();
+    if (_mapped) {
+        _file.unmap(_mapped);
+        _mapped = nullptr;
+    }
+    _file.close();
+}
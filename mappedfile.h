@@ -0,0 +1,50 @@
+/*
+ * This is an open source non-commercial project. Dear PVS-Studio, please check it.
+ * PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+ *
+ * Copyright (C) 2019  Ivan Romanov <drizt72@zoho.eu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#pragma once
+
+#include <QFile>
+#include <QByteArray>
+
+// Read-only file content. The file is mapped to memory when possible
+// and read to the heap otherwise. data() refers to the mapping so neither
+// it nor its shallow copies may outlive MappedFile. "-" reads stdin.
+class MappedFile
+{
+public:
+    explicit MappedFile(const QString &fileName);
+    ~MappedFile();
+
+    bool open();
+    void close();
+
+    inline QByteArray data() const { return _data; }
+    inline bool isMapped() const { return _mapped != nullptr; }
+    inline QString errorString() const { return _file.errorString(); }
+
+private:
+    Q_DISABLE_COPY(MappedFile)
+
+    QFile _file;
+    QByteArray _data;
+    uchar *_mapped;
+};
@@ -0,0 +1,290 @@
+/*
+ * This is an open source non-commercial project. Dear PVS-Studio, please check it.
+ * PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+ *
+ * Copyright (C) 2019  Ivan Romanov <drizt72@zoho.eu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "pieceindex.h"
+#include "bencode.h"
+#include "functiontask.h"
+#include "mappedfile.h"
+
+#include <QCryptographicHash>
+#include <QHash>
+#include <QPair>
+#include <QThreadPool>
+#include <QtEndian>
+
+#include <algorithm>
+
+namespace {
+
+const int HashSize = 20;
+
+} // namespace
+
+PieceIndex::PieceIndex()
+{
+}
+
+void PieceIndex::build(const QList<Batch::Input> &inputs, Batch &batch)
+{
+    _torrents.clear();
+    for (QVector<Entry> &shard: _shards) {
+        shard.clear();
+    }
+
+    // Slots are filled by tasks, so order doesn't depend on threads
+    QHash<QString, int> slotIndex;
+    for (const Batch::Input &input: inputs) {
+        if (slotIndex.contains(input.path))
+            continue;
+
+        slotIndex.insert(input.path, _torrents.size());
+        Torrent torrent;
+        torrent.path = input.path;
+        torrent.pieceCount = 0;
+        _torrents << torrent;
+    }
+
+    const QHash<QString, int> &constSlotIndex = slotIndex;
+    batch.run(inputs, [this, &constSlotIndex](const Batch::Input &input, QString *error) {
+        return add(input.path, constSlotIndex.value(input.path), error);
+    });
+
+    // Drop failed torrents and renumber the rest
+    QVector<quint32> newIndex(_torrents.size());
+    QList<Torrent> torrents;
+    for (int i = 0; i < _torrents.size(); ++i) {
+        newIndex[i] = torrents.size();
+        if (!_torrents.at(i).infoHash.isEmpty())
+            torrents << _torrents.at(i);
+    }
+    _torrents = torrents;
+
+    for (QVector<Entry> &shard: _shards) {
+        for (Entry &entry: shard) {
+            entry.torrent = newIndex.at(entry.torrent);
+        }
+    }
+
+    sortShards(batch.threadCount());
+}
+
+bool PieceIndex::add(const QString &path, int index, QString *errorString)
+{
+    MappedFile file(path);
+    if (!file.open()) {
+        *errorString = QStringLiteral("can't open file");
+        return false;
+    }
+
+    QByteArray raw = file.data();
+    QList<Bencode::RawSpan> spans;
+    QList<Bencode::RawSpan> infoSpans;
+    const Bencode::RawSpan *info = Bencode::dictionarySpans(raw, spans) ? Bencode::findSpan(spans, "info") : nullptr;
+    if (!info || !Bencode::dictionarySpans(raw, infoSpans, info->begin)) {
+        *errorString = QStringLiteral("no info dictionary");
+        return false;
+    }
+
+    // pieces value is "length:hashes"
+    const Bencode::RawSpan *pieces = Bencode::findSpan(infoSpans, "pieces");
+    int begin = pieces ? raw.indexOf(':', pieces->begin) + 1 : 0;
+    if (!pieces || begin <= 0 || begin > pieces->end || (pieces->end - begin) % HashSize) {
+        *errorString = QStringLiteral("wrong pieces");
+        return false;
+    }
+
+    QByteArray hashes = QByteArray::fromRawData(raw.constData() + begin, pieces->end - begin);
+    QByteArray infoRaw = QByteArray::fromRawData(raw.constData() + info->begin, info->end - info->begin);
+
+    // Sort by shards out of the lock
+    const int pieceCount = hashes.size() / HashSize;
+    QVector<Entry> entries[ShardCount];
+    for (int i = 0; i < pieceCount; ++i) {
+        const uchar *hash = reinterpret_cast<const uchar*>(hashes.constData()) + i * HashSize;
+        Entry entry;
+        entry.key = qFromBigEndian<quint64>(hash);
+        entry.torrent = index;
+        entry.piece = i;
+        entries[hash[0]] << entry;
+    }
+
+    Torrent torrent;
+    torrent.path = path;
+    torrent.infoHash = QCryptographicHash::hash(infoRaw, QCryptographicHash::Sha1);
+    torrent.piecesHash = QCryptographicHash::hash(hashes, QCryptographicHash::Sha1);
+    torrent.pieceCount = pieceCount;
+
+    QMutexLocker locker(&_mutex);
+    _torrents[index] = torrent;
+    for (int i = 0; i < ShardCount; ++i) {
+        _shards[i] += entries[i];
+    }
+    return true;
+}
+
+void PieceIndex::sortShards(int threadCount)
+{
+    QThreadPool pool;
+    pool.setMaxThreadCount(threadCount);
+
+    for (QVector<Entry> &shard: _shards) {
+        QVector<Entry> *entries = &shard;
+        pool.start(makeTask([entries]() {
+            std::sort(entries->begin(), entries->end(), [](const Entry &a, const Entry &b) {
+                return a.key < b.key || (a.key == b.key && (a.torrent < b.torrent || (a.torrent == b.torrent && a.piece < b.piece)));
+            });
+        }));
+    }
+
+    pool.waitForDone();
+}
+
+const QList<PieceIndex::Torrent> &PieceIndex::torrents() const
+{
+    return _torrents;
+}
+
+QList<QList<int>> PieceIndex::groups(const QList<int> &torrents, QByteArray Torrent::*field) const
+{
+    QHash<QByteArray, QList<int>> byHash;
+    QList<QByteArray> order;
+    for (int i: torrents) {
+        const QByteArray &hash = _torrents.at(i).*field;
+        if (!byHash.contains(hash))
+            order << hash;
+        byHash[hash] << i;
+    }
+
+    QList<QList<int>> res;
+    for (const QByteArray &hash: order) {
+        const QList<int> &group = byHash[hash];
+        if (group.size() > 1)
+            res << group;
+    }
+    return res;
+}
+
+QList<QList<int>> PieceIndex::sameInfoHash() const
+{
+    QList<int> all;
+    for (int i = 0; i < _torrents.size(); ++i) {
+        all << i;
+    }
+    return groups(all, &Torrent::infoHash);
+}
+
+QList<QList<int>> PieceIndex::samePieces() const
+{
+    QList<int> firsts;
+    QHash<QByteArray, bool> seen;
+    for (int i = 0; i < _torrents.size(); ++i) {
+        const QByteArray &infoHash = _torrents.at(i).infoHash;
+        if (!seen.contains(infoHash)) {
+            seen.insert(infoHash, true);
+            firsts << i;
+        }
+    }
+    return groups(firsts, &Torrent::piecesHash);
+}
+
+QList<PieceIndex::Overlap> PieceIndex::overlaps(int minShared, int maxSharing) const
+{
+    // Torrents with the same pieces are counted as the first of them
+    QVector<int> first(_torrents.size());
+    QHash<QByteArray, int> byPieces;
+    for (int i = 0; i < _torrents.size(); ++i) {
+        const QByteArray &piecesHash = _torrents.at(i).piecesHash;
+        if (!byPieces.contains(piecesHash))
+            byPieces.insert(piecesHash, i);
+        first[i] = byPieces.value(piecesHash);
+    }
+
+    // Pair of torrents packed to one key
+    QHash<quint64, Overlap> pairs;
+    QVector<QPair<int, int>> run;
+    for (const QVector<Entry> &shard: _shards) {
+        for (int begin = 0; begin < shard.size(); ) {
+            int end = begin + 1;
+            while (end < shard.size() && shard.at(end).key == shard.at(begin).key) {
+                ++end;
+            }
+
+            // Distinct torrents of the piece with its lowest position.
+            // Entries are sorted by torrent and piece inside of the run.
+            run.clear();
+            for (int i = begin; i < end; ++i) {
+                const Entry &entry = shard.at(i);
+                int torrent = first.at(entry.torrent);
+                bool found = false;
+                for (const QPair<int, int> &item: run) {
+                    if (item.first == torrent) {
+                        found = true;
+                        break;
+                    }
+                }
+                if (!found) {
+                    run << qMakePair(torrent, static_cast<int>(entry.piece));
+                    if (run.size() > maxSharing)
+                        break;
+                }
+            }
+            begin = end;
+
+            if (run.size() < 2 || run.size() > maxSharing)
+                continue;
+
+            std::sort(run.begin(), run.end());
+            for (int a = 0; a < run.size(); ++a) {
+                for (int b = a + 1; b < run.size(); ++b) {
+                    quint64 key = (static_cast<quint64>(run.at(a).first) << 32) | static_cast<quint32>(run.at(b).first);
+                    auto it = pairs.find(key);
+                    if (it == pairs.end()) {
+                        Overlap overlap;
+                        overlap.first = run.at(a).first;
+                        overlap.second = run.at(b).first;
+                        overlap.shared = 0;
+                        overlap.firstPiece = run.at(a).second;
+                        overlap.secondPiece = run.at(b).second;
+                        it = pairs.insert(key, overlap);
+                    }
+                    it->shared++;
+                    it->firstPiece = qMin(it->firstPiece, run.at(a).second);
+                    it->secondPiece = qMin(it->secondPiece, run.at(b).second);
+                }
+            }
+        }
+    }
+
+    QList<Overlap> res;
+    for (const Overlap &overlap: pairs) {
+        if (overlap.shared >= minShared)
+            res << overlap;
+    }
+
+    // Biggest overlaps first
+    std::sort(res.begin(), res.end(), [](const Overlap &a, const Overlap &b) {
+        if (a.shared != b.shared)
+            return a.shared > b.shared;
+        return a.first < b.first || (a.first == b.first && a.second < b.second);
+    });
+    return res;
+}
@@ -0,0 +1,101 @@
+/*
+ * This is an open source non-commercial project. Dear PVS-Studio, please check it.
+ * PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+ *
+ * Copyright (C) 2019  Ivan Romanov <drizt72@zoho.eu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#pragma once
+
+#include "batch.h"
+
+#include <QByteArray>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+
+// Finds torrents which share content. Every piece hash of every torrent
+// is kept as 16 bytes: 64 bit prefix of the hash, torrent and piece
+// numbers. Entries are split to shards by the first hash byte and sorted,
+// so equal pieces are neighbours and no pair of torrents is compared.
+class PieceIndex
+{
+public:
+    struct Torrent
+    {
+        QString path;
+        // SHA1 of info bytes and of pieces string, raw 20 bytes
+        QByteArray infoHash;
+        QByteArray piecesHash;
+        int pieceCount;
+    };
+
+    struct Overlap
+    {
+        int first;
+        int second;
+        // Number of distinct shared pieces
+        int shared;
+        // Lowest shared piece in each torrent
+        int firstPiece;
+        int secondPiece;
+    };
+
+    PieceIndex();
+
+    // Reads torrents on the batch thread pool and sorts the index
+    // with the same number of threads.
+    // Failed files are counted by batch and skipped. Torrents keep
+    // the order of inputs.
+    void build(const QList<Batch::Input> &inputs, Batch &batch);
+
+    const QList<Torrent> &torrents() const;
+
+    // Groups of two and more torrents. Torrents are indexes in torrents().
+    QList<QList<int>> sameInfoHash() const;
+    // Same pieces but different info hash. First torrent of every info hash.
+    QList<QList<int>> samePieces() const;
+
+    // Pairs of torrents with at least minShared common pieces. Torrents with
+    // the same pieces are reported once. Pieces found in more than maxSharing
+    // torrents, like zero filled ones, are ignored.
+    // Pieces are compared as is, so shared files must be aligned to piece
+    // boundaries of the same piece size.
+    QList<Overlap> overlaps(int minShared = 1, int maxSharing = 64) const;
+
+private:
+    Q_DISABLE_COPY(PieceIndex)
+
+    struct Entry
+    {
+        quint64 key;
+        quint32 torrent;
+        quint32 piece;
+    };
+
+    enum { ShardCount = 256 };
+
+    bool add(const QString &path, int index, QString *errorString);
+    void sortShards(int threadCount);
+    QList<QList<int>> groups(const QList<int> &torrents, QByteArray Torrent::*field) const;
+
+    QList<Torrent> _torrents;
+    QVector<Entry> _shards[ShardCount];
+    QMutex _mutex;
+};
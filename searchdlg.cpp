@@ -207,9 +207,11 @@ void SearchDlg::replaceAll()
         return;
 
     QString replaceStr = ui->lneReplace->text();
+    _model->beginUndoGroup();
     for (const auto &item: _searchList) {
         _model->setData(item, replaceStr, Qt::UserRole + (ui->chkHex->isChecked() ? 1 : 0));
     }
+    _model->endUndoGroup();
 
     QString resStr = tr("%n value(s) was(were) replaced", 0, _searchList.size());
     resetSearchList();
@@ -0,0 +1,168 @@
+/*
+ * This is an open source non-commercial project. Dear PVS-Studio, please check it.
+ * PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+ *
+ * Copyright (C) 2019  Ivan Romanov <drizt72@zoho.eu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+#include "bencodemodeltest.h"
+#include "bencodemodel.h"
+
+#include <QtTest>
+
+#include <functional>
+
+namespace {
+
+// Keys are sorted, so toRaw() gives the same bytes
+const char Torrent[] = "d8:announce3:abc13:creation datei100e4:infod6:lengthi5e4:name1:a12:piece lengthi16384eee";
+const char Empty[] = "d8:announce3:abce";
+
+// Change must be one undo step. Undo restores raw, redo repeats the change.
+void checkUndoRedo(const QByteArray &raw, const std::function<void(BencodeModel &)> &change)
+{
+    // Report only the first failure of the test
+    if (QTest::currentTestFailed())
+        return;
+
+    BencodeModel model;
+    model.setRaw(raw);
+    model.clearUndo();
+    QCOMPARE(model.toRaw(), raw);
+
+    change(model);
+    const QByteArray changed = model.toRaw();
+    QVERIFY(changed != raw);
+
+    QVERIFY(model.canUndo());
+    model.undo();
+    QCOMPARE(model.toRaw(), raw);
+    QVERIFY(!model.canUndo());
+
+    QVERIFY(model.canRedo());
+    model.redo();
+    QCOMPARE(model.toRaw(), changed);
+
+    model.undo();
+    QCOMPARE(model.toRaw(), raw);
+}
+
+} // namespace
+
+void BencodeModelTest::setComment()
+{
+    // New item is inserted before "creation date"
+    checkUndoRedo(Torrent, [](BencodeModel &model) { model.setComment(QStringLiteral("text")); });
+}
+
+void BencodeModelTest::removeComment()
+{
+    checkUndoRedo("d8:announce3:abc7:comment4:texte", [](BencodeModel &model) { model.setComment(QString()); });
+}
+
+void BencodeModelTest::setName()
+{
+    // Creates "info" and an item inside it
+    checkUndoRedo(Empty, [](BencodeModel &model) { model.setName(QStringLiteral("name")); });
+    checkUndoRedo(Torrent, [](BencodeModel &model) { model.setName(QStringLiteral("other")); });
+}
+
+void BencodeModelTest::setPieceSize()
+{
+    checkUndoRedo(Empty, [](BencodeModel &model) { model.setPieceSize(32768); });
+    checkUndoRedo(Torrent, [](BencodeModel &model) { model.setPieceSize(0); });
+}
+
+void BencodeModelTest::setPrivateTorrent()
+{
+    checkUndoRedo(Empty, [](BencodeModel &model) { model.setPrivateTorrent(true); });
+    checkUndoRedo(Torrent, [](BencodeModel &model) { model.setPrivateTorrent(true); });
+}
+
+void BencodeModelTest::setTrackers()
+{
+    checkUndoRedo(Torrent, [](BencodeModel &model) {
+        model.setTrackers(QStringList() << QStringLiteral("x") << QStringLiteral("y"));
+    });
+    checkUndoRedo("d8:announce1:x13:announce-listll1:xel1:yel1:zeee", [](BencodeModel &model) {
+        model.setTrackers(QStringList() << QStringLiteral("y"));
+    });
+}
+
+void BencodeModelTest::removeTrackers()
+{
+    checkUndoRedo("d8:announce1:x13:announce-listll1:xel1:yeee", [](BencodeModel &model) {
+        model.setTrackers(QStringList());
+    });
+}
+
+void BencodeModelTest::setFiles()
+{
+    QList<QPair<QString, qlonglong>> files;
+    files << qMakePair(QStringLiteral("a/b"), 1LL) << qMakePair(QStringLiteral("c"), 2LL);
+    checkUndoRedo(Torrent, [&files](BencodeModel &model) { model.setFiles(files); });
+    checkUndoRedo(Empty, [&files](BencodeModel &model) { model.setFiles(files); });
+}
+
+void BencodeModelTest::insertRows()
+{
+    checkUndoRedo(Torrent, [](BencodeModel &model) { model.insertRows(1, 2, model.index(0, 0)); });
+}
+
+void BencodeModelTest::removeRows()
+{
+    checkUndoRedo(Torrent, [](BencodeModel &model) { model.removeRows(0, 2, model.index(0, 0)); });
+
+    // Rows inside a dictionary of the document
+    checkUndoRedo(Torrent, [](BencodeModel &model) {
+        QModelIndex info = model.index(2, 0, model.index(0, 0));
+        model.removeRows(0, 3, info);
+    });
+}
+
+void BencodeModelTest::group()
+{
+    checkUndoRedo(Empty, [](BencodeModel &model) {
+        model.beginUndoGroup();
+        model.setName(QStringLiteral("name"));
+        model.setComment(QStringLiteral("text"));
+        model.setPieceSize(16384);
+        model.setTrackers(QStringList() << QStringLiteral("x"));
+        model.endUndoGroup();
+    });
+}
+
+void BencodeModelTest::undoLimit()
+{
+    BencodeModel model;
+    model.setRaw(Torrent);
+    model.setUndoLimit(0);
+    QVERIFY(!model.canUndo());
+
+    model.setComment(QStringLiteral("text"));
+    model.removeRows(0, 1, model.index(0, 0));
+    QVERIFY(!model.canUndo());
+    QCOMPARE(model.comment(), QStringLiteral("text"));
+}
+
+#ifdef HAVE_QT5
+QTEST_GUILESS_MAIN(BencodeModelTest)
+#else
+QTEST_MAIN(BencodeModelTest)
+#endif
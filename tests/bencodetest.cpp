@@ -0,0 +1,227 @@
+/*
+ * This is an open source non-commercial project. Dear PVS-Studio, please check it.
+ * PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+ *
+ * Copyright (C) 2019  Ivan Romanov <drizt72@zoho.eu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+#include "bencodetest.h"
+#include "bencode.h"
+
+#include <QtTest>
+#include <QBuffer>
+#include <QScopedPointer>
+
+void BencodeTest::compareEqual_data()
+{
+    QTest::addColumn<QByteArray>("raw");
+
+    QTest::newRow("integer") << QByteArray("i-42e");
+    QTest::newRow("string") << QByteArray("4:spam");
+    QTest::newRow("list") << QByteArray("l4:spami1ee");
+    QTest::newRow("dictionary") << QByteArray("d1:ai1e1:bl1:x1:yee");
+    QTest::newRow("nested") << QByteArray("d4:infod5:filesld6:lengthi5e4:pathl1:aeeee4:name4:testee");
+    QTest::newRow("empty") << QByteArray("d1:ale1:bdee");
+}
+
+void BencodeTest::compareEqual()
+{
+    QFETCH(QByteArray, raw);
+
+    QScopedPointer<Bencode> first(Bencode::fromRaw(raw));
+    QScopedPointer<Bencode> second(Bencode::fromRaw(raw));
+    QVERIFY(first->isValid());
+    QVERIFY(first->compare(second.data()));
+    QVERIFY(second->compare(first.data()));
+    QVERIFY(first->fingerprint() == second->fingerprint());
+}
+
+void BencodeTest::compareDifferent_data()
+{
+    QTest::addColumn<QByteArray>("first");
+    QTest::addColumn<QByteArray>("second");
+
+    QTest::newRow("integer") << QByteArray("d1:ai1ee") << QByteArray("d1:ai2ee");
+    QTest::newRow("string") << QByteArray("d1:a1:xe") << QByteArray("d1:a1:ye");
+    QTest::newRow("type") << QByteArray("d1:ai1ee") << QByteArray("d1:a1:1e");
+    QTest::newRow("key") << QByteArray("d1:ai1ee") << QByteArray("d1:bi1ee");
+    QTest::newRow("order") << QByteArray("li1ei2ee") << QByteArray("li2ei1ee");
+    QTest::newRow("size") << QByteArray("li1ee") << QByteArray("li1ei1ee");
+    QTest::newRow("string boundaries") << QByteArray("l2:ab1:ce") << QByteArray("l1:a2:bce");
+    QTest::newRow("nesting") << QByteArray("lli1eeli2eee") << QByteArray("lli1ei2eee");
+    QTest::newRow("deep leaf") << QByteArray("d1:ad1:bli1eeee") << QByteArray("d1:ad1:bli2eeee");
+}
+
+void BencodeTest::compareDifferent()
+{
+    QFETCH(QByteArray, first);
+    QFETCH(QByteArray, second);
+
+    QScopedPointer<Bencode> firstItem(Bencode::fromRaw(first));
+    QScopedPointer<Bencode> secondItem(Bencode::fromRaw(second));
+    QVERIFY(firstItem->isValid());
+    QVERIFY(secondItem->isValid());
+    QVERIFY(!firstItem->compare(secondItem.data()));
+    QVERIFY(!secondItem->compare(firstItem.data()));
+}
+
+void BencodeTest::compareAfterChange()
+{
+    QScopedPointer<Bencode> original(Bencode::fromRaw("d1:ad1:bli1ei2eee1:ci3ee"));
+    QScopedPointer<Bencode> copy(original->clone());
+    QVERIFY(original->compare(copy.data()));
+
+    // Cached fingerprints of all parents must be dropped
+    Bencode *leaf = copy->child("a")->child("b")->child(1);
+    leaf->setInteger(5);
+    QVERIFY(!original->compare(copy.data()));
+    QVERIFY(original->fingerprint() != copy->fingerprint());
+
+    leaf->setInteger(2);
+    QVERIFY(original->compare(copy.data()));
+    QVERIFY(original->fingerprint() == copy->fingerprint());
+
+    copy->child("a")->child("b")->appendChild(new Bencode(3));
+    QVERIFY(!original->compare(copy.data()));
+}
+
+void BencodeTest::compareSharedClone()
+{
+    QScopedPointer<Bencode> shared(Bencode::share(Bencode::fromRaw("d1:ad1:bli1eee1:c1:xe")));
+    QScopedPointer<Bencode> first(shared->clone());
+    QScopedPointer<Bencode> second(shared->clone());
+    QVERIFY(first->compare(second.data()));
+
+    second->child("c")->setString("y");
+    QVERIFY(!first->compare(second.data()));
+    QVERIFY(first->compare(shared.data()));
+}
+
+void BencodeTest::fingerprint()
+{
+    QScopedPointer<Bencode> first(Bencode::fromRaw("d1:ai1e1:bi2ee"));
+    QScopedPointer<Bencode> second(Bencode::fromRaw("d1:ai1e1:bi2ee"));
+
+    // Key of the item itself is not counted
+    second->setKey("other");
+    QVERIFY(first->fingerprint() == second->fingerprint());
+
+    // Keys of children are counted
+    second->child("b")->setKey("c");
+    QVERIFY(first->fingerprint() != second->fingerprint());
+}
+
+void BencodeTest::jsonRoundTrip_data()
+{
+    QTest::addColumn<int>("format");
+    QTest::addColumn<int>("blobEncoding");
+
+    QTest::newRow("indented") << static_cast<int>(Bencode::JsonFormat::Indented) << static_cast<int>(Bencode::BlobEncoding::Escaped);
+    QTest::newRow("compact") << static_cast<int>(Bencode::JsonFormat::Compact) << static_cast<int>(Bencode::BlobEncoding::Escaped);
+    QTest::newRow("hex") << static_cast<int>(Bencode::JsonFormat::Compact) << static_cast<int>(Bencode::BlobEncoding::Hex);
+    QTest::newRow("base64") << static_cast<int>(Bencode::JsonFormat::Compact) << static_cast<int>(Bencode::BlobEncoding::Base64);
+}
+
+void BencodeTest::jsonRoundTrip()
+{
+    QFETCH(int, format);
+    QFETCH(int, blobEncoding);
+
+    QByteArray bytes;
+    for (int i = 0; i < 256; ++i) {
+        bytes += static_cast<char>(i);
+    }
+
+    // Long strings cross the 16 byte vector steps and the 16 KiB chunks
+    // of the writer. Every quote and backslash is escaped in place.
+    QByteArray quotes = QByteArray("say \"hi\" \\ back\\\"").repeated(2000);
+    QByteArray mixed = (QByteArray("\"\\\x01%\x7f\xff plain text") + bytes).repeated(100);
+
+    Bencode root(Bencode::Type::Dictionary);
+    root.appendMapItem(new Bencode(bytes, "all bytes"));
+    root.appendMapItem(new Bencode(quotes, "quotes"));
+    root.appendMapItem(new Bencode(mixed, "mixed"));
+    root.appendMapItem(new Bencode(QByteArray("value"), "\"quoted\\key\n%"));
+    root.appendMapItem(new Bencode(Bencode::Type::List, "list"));
+    root.child("list")->appendChild(new Bencode(QByteArray("\\")));
+    root.child("list")->appendChild(new Bencode(QByteArray("\"")));
+    root.child("list")->appendChild(new Bencode(-42));
+
+    Bencode *pieces = new Bencode(bytes.repeated(3), "pieces");
+    pieces->setHex(true);
+    root.appendMapItem(pieces);
+
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    QVERIFY(root.toJson(&buffer, static_cast<Bencode::JsonFormat>(format), static_cast<Bencode::BlobEncoding>(blobEncoding)));
+    const QByteArray json = buffer.data();
+
+    // Non-printable bytes are escaped, so junk in the buffer is visible
+    for (int i = 0; i < json.size(); ++i) {
+        const char c = json.at(i);
+        QVERIFY2((c >= ' ' && c <= '~') || c == '\n', qPrintable(QStringLiteral("byte %1 at %2").arg(static_cast<uchar>(c)).arg(i)));
+    }
+
+    QString errorString;
+    QScopedPointer<Bencode> parsed(Bencode::fromJson(json, &errorString));
+    QVERIFY2(parsed, qPrintable(errorString));
+    QVERIFY(root.compare(parsed.data()));
+    QCOMPARE(parsed->toRaw(), root.toRaw());
+
+    // Raw converter writes the same text
+    QBuffer rawBuffer;
+    rawBuffer.open(QIODevice::WriteOnly);
+    QVERIFY(Bencode::rawToJson(root.toRaw(), &rawBuffer, static_cast<Bencode::JsonFormat>(format), static_cast<Bencode::BlobEncoding>(blobEncoding)));
+    QCOMPARE(rawBuffer.data(), json);
+}
+
+void BencodeTest::jsonWideContainer()
+{
+    // Wide containers are written by chunks on a thread pool
+    Bencode root(Bencode::Type::Dictionary);
+    root.appendMapItem(new Bencode(Bencode::Type::List, "list"));
+    root.appendMapItem(new Bencode(Bencode::Type::Dictionary, "map"));
+    for (int i = 0; i < 20000; ++i) {
+        QByteArray key = QByteArray::number(i).rightJustified(5, '0');
+        root.child("list")->appendChild(new Bencode(QByteArray("item \"") + key));
+        Bencode *item = new Bencode(Bencode::Type::List, key);
+        item->appendChild(new Bencode(i));
+        root.child("map")->appendMapItem(item);
+    }
+
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    QVERIFY(root.toJson(&buffer));
+
+    // Serial converter gives the reference text
+    QBuffer rawBuffer;
+    rawBuffer.open(QIODevice::WriteOnly);
+    QVERIFY(Bencode::rawToJson(root.toRaw(), &rawBuffer));
+    QCOMPARE(buffer.data(), rawBuffer.data());
+
+    QScopedPointer<Bencode> parsed(Bencode::fromJson(buffer.data()));
+    QVERIFY(parsed);
+    QVERIFY(root.compare(parsed.data()));
+}
+
+#ifdef HAVE_QT5
+QTEST_GUILESS_MAIN(BencodeTest)
+#else
+QTEST_MAIN(BencodeTest)
+#endif
@@ -0,0 +1,240 @@
+/*
+ * This is an open source non-commercial project. Dear PVS-Studio, please check it.
+ * PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+ *
+ * Copyright (C) 2019  Ivan Romanov <drizt72@zoho.eu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+#include "torrentrewritertest.h"
+#include "torrentrewriter.h"
+
+#include <QtTest>
+#include <QTemporaryFile>
+
+namespace {
+
+// Keys of info are not sorted and x-extra is unknown. Both must survive
+// every rewrite byte for byte.
+const char Torrent[] = "d8:announce1:a7:comment3:old13:creation datei100e4:infod4:name1:x6:lengthi1ee7:x-extrali1e0:ee";
+
+} // namespace
+
+void TorrentRewriterTest::noEdits()
+{
+    TorrentRewriter rewriter;
+    QVERIFY(!rewriter.hasEdits());
+
+    QByteArray result;
+    QVERIFY(rewriter.rewrite(Torrent, result));
+    QCOMPARE(result, QByteArray(Torrent));
+}
+
+void TorrentRewriterTest::sameValues()
+{
+    TorrentRewriter rewriter;
+    rewriter.setComment(QStringLiteral("old"));
+    rewriter.setTrackers(QStringList() << QStringLiteral("a"));
+    rewriter.setPrivateTorrent(false);
+    rewriter.setCreatedBy(QString());
+    QVERIFY(rewriter.hasEdits());
+
+    // announce-list is added, everything else is the same
+    QByteArray result;
+    QVERIFY(rewriter.rewrite(Torrent, result));
+    QCOMPARE(result, QByteArray("d8:announce1:a13:announce-listll1:aee7:comment3:old13:creation datei100e4:infod4:name1:x6:lengthi1ee7:x-extrali1e0:ee"));
+    QCOMPARE(TorrentRewriter::infoHash(result), TorrentRewriter::infoHash(Torrent));
+}
+
+void TorrentRewriterTest::setComment_data()
+{
+    QTest::addColumn<QByteArray>("raw");
+    QTest::addColumn<QString>("comment");
+    QTest::addColumn<QByteArray>("result");
+
+    QTest::newRow("replace") << QByteArray(Torrent) << QStringLiteral("new")
+                             << QByteArray("d8:announce1:a7:comment3:new13:creation datei100e4:infod4:name1:x6:lengthi1ee7:x-extrali1e0:ee");
+    QTest::newRow("remove") << QByteArray(Torrent) << QString()
+                            << QByteArray("d8:announce1:a13:creation datei100e4:infod4:name1:x6:lengthi1ee7:x-extrali1e0:ee");
+    QTest::newRow("insert") << QByteArray("d8:announce1:a13:creation datei100e4:infod4:name1:xee")
+                            << QStringLiteral("new")
+                            << QByteArray("d8:announce1:a7:comment3:new13:creation datei100e4:infod4:name1:xee");
+    QTest::newRow("append") << QByteArray("d8:announce1:ae") << QStringLiteral("new")
+                            << QByteArray("d8:announce1:a7:comment3:newe");
+    QTest::newRow("utf-8") << QByteArray("de") << QString::fromUtf8("\xd0\xaf")
+                           << QByteArray("d7:comment2:\xd0\xaf" "e");
+}
+
+void TorrentRewriterTest::setComment()
+{
+    QFETCH(QByteArray, raw);
+    QFETCH(QString, comment);
+    QFETCH(QByteArray, result);
+
+    TorrentRewriter rewriter;
+    rewriter.setComment(comment);
+
+    QByteArray rewritten;
+    QVERIFY(rewriter.rewrite(raw, rewritten));
+    QCOMPARE(rewritten, result);
+    QCOMPARE(TorrentRewriter::infoHash(rewritten), TorrentRewriter::infoHash(raw));
+}
+
+void TorrentRewriterTest::setTrackers_data()
+{
+    QTest::addColumn<QStringList>("trackers");
+    QTest::addColumn<QByteArray>("result");
+
+    QTest::newRow("two") << (QStringList() << QStringLiteral("b") << QStringLiteral("c"))
+                         << QByteArray("d8:announce1:b13:announce-listll1:bel1:cee7:comment3:old13:creation datei100e4:infod4:name1:x6:lengthi1ee7:x-extrali1e0:ee");
+    QTest::newRow("remove") << QStringList()
+                            << QByteArray("d7:comment3:old13:creation datei100e4:infod4:name1:x6:lengthi1ee7:x-extrali1e0:ee");
+}
+
+void TorrentRewriterTest::setTrackers()
+{
+    QFETCH(QStringList, trackers);
+    QFETCH(QByteArray, result);
+
+    TorrentRewriter rewriter;
+    rewriter.setTrackers(trackers);
+
+    QByteArray rewritten;
+    QVERIFY(rewriter.rewrite(Torrent, rewritten));
+    QCOMPARE(rewritten, result);
+}
+
+void TorrentRewriterTest::setUrlList()
+{
+    TorrentRewriter rewriter;
+    rewriter.setUrlList(QStringList() << QStringLiteral("u") << QStringLiteral("v"));
+
+    // url-list is a flat list of strings unlike announce-list
+    QByteArray rewritten;
+    QVERIFY(rewriter.rewrite(Torrent, rewritten));
+    QCOMPARE(rewritten, QByteArray("d8:announce1:a7:comment3:old13:creation datei100e4:infod4:name1:x6:lengthi1ee8:url-listl1:u1:ve7:x-extrali1e0:ee"));
+
+    rewriter.setUrlList(QStringList());
+    QByteArray removed;
+    QVERIFY(rewriter.rewrite(rewritten, removed));
+    QCOMPARE(removed, QByteArray(Torrent));
+}
+
+void TorrentRewriterTest::setPrivateTorrent_data()
+{
+    QTest::addColumn<QByteArray>("raw");
+    QTest::addColumn<bool>("privateTorrent");
+    QTest::addColumn<QByteArray>("result");
+
+    QTest::newRow("set") << QByteArray(Torrent) << true
+                         << QByteArray("d8:announce1:a7:comment3:old13:creation datei100e4:infod4:name1:x6:lengthi1e7:privatei1ee7:x-extrali1e0:ee");
+    QTest::newRow("unset") << QByteArray("d4:infod6:lengthi1e4:name1:x7:privatei1eee") << false
+                           << QByteArray("d4:infod6:lengthi1e4:name1:xee");
+    QTest::newRow("already set") << QByteArray("d4:infod6:lengthi1e4:name1:x7:privatei1eee") << true
+                                 << QByteArray("d4:infod6:lengthi1e4:name1:x7:privatei1eee");
+    QTest::newRow("already unset") << QByteArray(Torrent) << false << QByteArray(Torrent);
+    QTest::newRow("no info") << QByteArray("d8:announce1:ae") << true << QByteArray("d8:announce1:ae");
+}
+
+void TorrentRewriterTest::setPrivateTorrent()
+{
+    QFETCH(QByteArray, raw);
+    QFETCH(bool, privateTorrent);
+    QFETCH(QByteArray, result);
+
+    TorrentRewriter rewriter;
+    rewriter.setPrivateTorrent(privateTorrent);
+
+    QByteArray rewritten;
+    QVERIFY(rewriter.rewrite(raw, rewritten));
+    QCOMPARE(rewritten, result);
+
+    // Info hash changes only with info bytes
+    QCOMPARE(TorrentRewriter::infoHash(rewritten) == TorrentRewriter::infoHash(raw), rewritten == raw);
+}
+
+void TorrentRewriterTest::trailingData()
+{
+    const QByteArray raw = QByteArray(Torrent) + "\r\ngarbage";
+
+    TorrentRewriter rewriter;
+    rewriter.setComment(QStringLiteral("new"));
+
+    QByteArray rewritten;
+    QVERIFY(rewriter.rewrite(raw, rewritten));
+    QVERIFY(rewritten.endsWith("e\r\ngarbage"));
+    QVERIFY(rewritten.contains("7:comment3:new"));
+}
+
+void TorrentRewriterTest::invalid_data()
+{
+    QTest::addColumn<QByteArray>("raw");
+    QTest::addColumn<bool>("privateTorrent");
+
+    QTest::newRow("empty") << QByteArray() << false;
+    QTest::newRow("list") << QByteArray("le") << false;
+    QTest::newRow("unterminated") << QByteArray("d8:announce1:a") << false;
+    QTest::newRow("short string") << QByteArray("d8:announce9:ae") << false;
+    QTest::newRow("info not dictionary") << QByteArray("d4:infoli1eee") << true;
+}
+
+void TorrentRewriterTest::invalid()
+{
+    QFETCH(QByteArray, raw);
+    QFETCH(bool, privateTorrent);
+
+    TorrentRewriter rewriter;
+    rewriter.setComment(QStringLiteral("new"));
+    if (privateTorrent)
+        rewriter.setPrivateTorrent(true);
+
+    QByteArray rewritten;
+    QString errorString;
+    QVERIFY(!rewriter.rewrite(raw, rewritten, &errorString));
+    QVERIFY(!errorString.isEmpty());
+}
+
+void TorrentRewriterTest::writeFile()
+{
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    file.write("old");
+    file.close();
+
+    // Existing file is replaced and no temporary files are left
+    QString errorString;
+    QVERIFY(TorrentRewriter::writeFile(file.fileName(), Torrent, &errorString));
+    QVERIFY(errorString.isEmpty());
+
+    QVERIFY(file.open());
+    QCOMPARE(file.readAll(), QByteArray(Torrent));
+    file.close();
+
+    const QFileInfo info(file.fileName());
+    QDir dir = info.dir();
+    QCOMPARE(dir.entryList(QStringList() << info.fileName() + QStringLiteral(".*")), QStringList());
+
+    QVERIFY(!TorrentRewriter::writeFile(dir.filePath(QStringLiteral("missing/file.torrent")), Torrent, &errorString));
+    QVERIFY(!errorString.isEmpty());
+}
+
+#ifdef HAVE_QT5
+QTEST_GUILESS_MAIN(TorrentRewriterTest)
+#else
+QTEST_MAIN(TorrentRewriterTest)
+#endif
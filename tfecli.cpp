@@ -0,0 +1,166 @@
+/*
+ * This is an open source non-commercial project. Dear PVS-Studio, please check it.
+ * PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+ *
+ * Copyright (C) 2019  Ivan Romanov <drizt72@zoho.eu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+// Command line only executable. Links QtCore and tfe-core, no GUI libraries.
+
+#include "cli.h"
+
+#ifdef HAVE_CATALOG
+# include "batch.h"
+# include "torrentcatalog.h"
+
+# include <QCoreApplication>
+# include <QFile>
+#endif
+
+#include <cstdio>
+#include <cstring>
+
+#ifdef HAVE_CATALOG
+namespace {
+
+// --index DB [--jobs=N] inputs...
+int runIndex(int argc, char *argv[])
+{
+    int jobs = 0;
+    QStringList args;
+    for (int i = 3; i < argc; ++i) {
+        QString arg = fromArgument(argv[i]);
+        bool ok = true;
+        if (!args.isEmpty() || !arg.startsWith(QLatin1String("--"))) {
+            args << arg;
+        }
+        else if (arg.startsWith(QLatin1String("--jobs="))) {
+            jobs = arg.mid(7).toInt(&ok);
+            ok = ok && jobs >= 0;
+        }
+        else {
+            ok = false;
+        }
+
+        if (!ok) {
+            qDebug("Error: wrong option %s", argv[i]);
+            return -1;
+        }
+    }
+
+    QList<Batch::Input> inputs;
+    QString errorString;
+    if (args.isEmpty() || !Batch::collectInputs(args, QStringList(QStringLiteral("*.torrent")), inputs, &errorString)) {
+        qDebug("Error: %s", args.isEmpty() ? "no inputs" : qPrintable(errorString));
+        return -1;
+    }
+
+    TorrentCatalog catalog;
+    if (!catalog.open(fromArgument(argv[2]), &errorString) || !catalog.update(inputs, jobs, &errorString)) {
+        qDebug("Error: %s", qPrintable(errorString));
+        return -1;
+    }
+
+    qDebug("%d indexed, %d unchanged, %d removed, %d failed", catalog.indexed(), catalog.unchanged(), catalog.removed(), catalog.failed());
+    return catalog.failed() ? -1 : 0;
+}
+
+// --query DB [--file-name=pattern] [--file-size=N]
+int runQuery(int argc, char *argv[])
+{
+    QString namePattern;
+    qlonglong size = -1;
+    for (int i = 3; i < argc; ++i) {
+        QString arg = fromArgument(argv[i]);
+        bool ok = true;
+        if (arg.startsWith(QLatin1String("--file-name="))) {
+            namePattern = arg.mid(12);
+        }
+        else if (arg.startsWith(QLatin1String("--file-size="))) {
+            size = arg.mid(12).toLongLong(&ok);
+            ok = ok && size >= 0;
+        }
+        else {
+            ok = false;
+        }
+
+        if (!ok) {
+            qDebug("Error: wrong option %s", argv[i]);
+            return -1;
+        }
+    }
+
+    TorrentCatalog catalog;
+    QList<TorrentCatalog::Match> matches;
+    QString errorString;
+    if (!catalog.open(fromArgument(argv[2]), &errorString) || !catalog.findFiles(namePattern, size, matches, &errorString)) {
+        qDebug("Error: %s", qPrintable(errorString));
+        return -1;
+    }
+
+    QFile out;
+    if (!out.open(stdout, QIODevice::WriteOnly)) {
+        qDebug("Error: can't open stdout");
+        return -1;
+    }
+
+    for (const TorrentCatalog::Match &match: matches) {
+        QByteArray line = "{\"torrent\":" + jsonString(match.torrentPath)
+                        + ",\"infohash\":" + jsonString(match.infoHash)
+                        + ",\"name\":" + jsonString(match.name)
+                        + ",\"file\":" + jsonString(match.filePath)
+                        + ",\"size\":" + QByteArray::number(match.fileSize)
+                        + "}\n";
+        out.write(line);
+    }
+    return 0;
+}
+
+} // namespace
+#endif
+
+int main(int argc, char *argv[])
+{
+    if (argc == 2 && !strcmp(argv[1], "--help")) {
+        printCliUsage("tfe-cli");
+#ifdef HAVE_CATALOG
+        printf("       tfe-cli --index DB [--jobs=N] inputs...\n"
+               "Adds new and changed torrents to SQLite database DB and drops deleted ones.\n"
+               "Unchanged files by size and modification time are not read.\n"
+               "       tfe-cli --query DB [--file-name=pattern] [--file-size=N]\n"
+               "Prints torrents containing matching files as JSON lines. Pattern may\n"
+               "have * and ? wildcards.\n");
+#endif
+        return 0;
+    }
+
+#ifdef HAVE_CATALOG
+    if (argc >= 3 && (!strcmp(argv[1], "--index") || !strcmp(argv[1], "--query"))) {
+        // Sql drivers are loaded as plugins
+        QCoreApplication app(argc, argv);
+        return !strcmp(argv[1], "--index") ? runIndex(argc, argv) : runQuery(argc, argv);
+    }
+#endif
+
+    if (!isCliCommand(argc, argv)) {
+        printCliUsage("tfe-cli");
+        return -1;
+    }
+
+    return runCli(argc, argv);
+}
@@ -0,0 +1,340 @@
+/*
+ * This is an open source non-commercial project. Dear PVS-Studio, please check it.
+ * PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+ *
+ * Copyright (C) 2019  Ivan Romanov <drizt72@zoho.eu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "torrentcatalog.h"
+#include "mappedfile.h"
+#include "torrentsummary.h"
+
+#include <QDateTime>
+#include <QFileInfo>
+#include <QHash>
+#include <QPair>
+#include <QSet>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QVariant>
+#include <QVector>
+
+namespace {
+
+// Parsed torrents are written to the database by chunks.
+// Limits memory and keeps transactions short.
+const int ChunkSize = 1024;
+
+const char *const Schema[] = {
+    "PRAGMA journal_mode = WAL",
+    "PRAGMA synchronous = NORMAL",
+    "PRAGMA foreign_keys = ON",
+    "CREATE TABLE IF NOT EXISTS torrents ("
+    " id INTEGER PRIMARY KEY,"
+    " path TEXT NOT NULL UNIQUE,"
+    " size INTEGER NOT NULL,"
+    " mtime INTEGER NOT NULL,"
+    " infohash TEXT NOT NULL,"
+    " name TEXT,"
+    " total_size INTEGER,"
+    " piece_size INTEGER,"
+    " file_count INTEGER,"
+    " private INTEGER,"
+    " trackers TEXT)",
+    "CREATE TABLE IF NOT EXISTS files ("
+    " torrent_id INTEGER NOT NULL REFERENCES torrents(id) ON DELETE CASCADE,"
+    " path TEXT NOT NULL,"
+    " name TEXT NOT NULL,"
+    " size INTEGER NOT NULL)",
+    "CREATE INDEX IF NOT EXISTS torrents_infohash ON torrents(infohash)",
+    "CREATE INDEX IF NOT EXISTS files_torrent ON files(torrent_id)",
+    "CREATE INDEX IF NOT EXISTS files_size ON files(size)",
+    "CREATE INDEX IF NOT EXISTS files_name ON files(name)"
+};
+
+struct Entry
+{
+    QString path;
+    qint64 size;
+    qint64 mtime;
+    bool ok;
+    TorrentSummary summary;
+};
+
+bool setError(const QSqlError &error, QString *errorString)
+{
+    if (errorString)
+        *errorString = error.text();
+    return false;
+}
+
+bool exec(QSqlQuery &query, QString *errorString)
+{
+    return query.exec() || setError(query.lastError(), errorString);
+}
+
+// Wildcard to LIKE pattern. % and _ are matched literally.
+QString likePattern(const QString &wildcard)
+{
+    QString res;
+    for (const QChar &c: wildcard) {
+        if (c == QLatin1Char('%') || c == QLatin1Char('_') || c == QLatin1Char('\\'))
+            res += QLatin1Char('\\');
+
+        if (c == QLatin1Char('*'))
+            res += QLatin1Char('%');
+        else if (c == QLatin1Char('?'))
+            res += QLatin1Char('_');
+        else
+            res += c;
+    }
+    return res;
+}
+
+} // namespace
+
+TorrentCatalog::TorrentCatalog()
+    : _connectionName(QStringLiteral("tfe-catalog-%1").arg(reinterpret_cast<quintptr>(this)))
+    , _indexed(0)
+    , _unchanged(0)
+    , _removed(0)
+    , _failed(0)
+{
+}
+
+TorrentCatalog::~TorrentCatalog()
+{
+    {
+        QSqlDatabase db = QSqlDatabase::database(_connectionName, false);
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(_connectionName);
+}
+
+bool TorrentCatalog::open(const QString &fileName, QString *errorString)
+{
+    QSqlDatabase db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), _connectionName);
+    db.setDatabaseName(fileName);
+    if (!db.open())
+        return setError(db.lastError(), errorString);
+
+    QSqlQuery query(db);
+    for (const char *statement: Schema) {
+        if (!query.exec(QString::fromLatin1(statement)))
+            return setError(query.lastError(), errorString);
+    }
+    return true;
+}
+
+bool TorrentCatalog::update(const QList<Batch::Input> &inputs, int threadCount, QString *errorString)
+{
+    _indexed = _unchanged = _removed = _failed = 0;
+
+    QSqlDatabase db = QSqlDatabase::database(_connectionName, false);
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+
+    // Size and mtime of indexed torrents
+    QHash<QString, QPair<qint64, qint64>> known;
+    if (!query.exec(QStringLiteral("SELECT path, size, mtime FROM torrents")))
+        return setError(query.lastError(), errorString);
+    while (query.next()) {
+        known.insert(query.value(0).toString(), qMakePair(query.value(1).toLongLong(), query.value(2).toLongLong()));
+    }
+
+    QVector<Entry> changed;
+    QSet<QString> seen;
+    for (const Batch::Input &input: inputs) {
+        QFileInfo fileInfo(input.path);
+        Entry entry;
+        entry.path = fileInfo.absoluteFilePath();
+        entry.size = fileInfo.size();
+        entry.mtime = fileInfo.lastModified().toMSecsSinceEpoch();
+        entry.ok = false;
+
+        if (seen.contains(entry.path))
+            continue;
+        seen.insert(entry.path);
+
+        auto it = known.constFind(entry.path);
+        if (it != known.constEnd() && it.value() == qMakePair(entry.size, entry.mtime))
+            _unchanged++;
+        else
+            changed << entry;
+    }
+
+    QSqlQuery removeTorrent(db);
+    removeTorrent.prepare(QStringLiteral("DELETE FROM torrents WHERE path = ?"));
+    QSqlQuery insertTorrent(db);
+    insertTorrent.prepare(QStringLiteral("INSERT INTO torrents (path, size, mtime, infohash, name, total_size, piece_size, file_count, private, trackers)"
+                                         " VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?)"));
+    QSqlQuery insertFile(db);
+    insertFile.prepare(QStringLiteral("INSERT INTO files (torrent_id, path, name, size) VALUES (?, ?, ?, ?)"));
+
+    // Files are deleted by cascade
+    auto remove = [&](const QString &path) {
+        removeTorrent.addBindValue(path);
+        return exec(removeTorrent, errorString);
+    };
+
+    Batch batch(threadCount);
+    for (int from = 0; from < changed.size(); from += ChunkSize) {
+        const int to = qMin(from + ChunkSize, changed.size());
+
+        // Tasks fill their own entries
+        QList<Batch::Input> chunk;
+        QHash<QString, int> entryIndex;
+        for (int i = from; i < to; ++i) {
+            Batch::Input input;
+            input.path = changed.at(i).path;
+            chunk << input;
+            entryIndex.insert(input.path, i);
+        }
+
+        Entry *entries = changed.data();
+        batch.run(chunk, [entries, &entryIndex](const Batch::Input &input, QString *error) {
+            Entry &entry = entries[entryIndex.value(input.path)];
+            MappedFile file(input.path);
+            if (!file.open()) {
+                *error = QStringLiteral("can't open file");
+                return false;
+            }
+            entry.ok = TorrentSummary::fromRaw(file.data(), entry.summary, error);
+            return entry.ok;
+        });
+
+        db.transaction();
+        for (int i = from; i < to; ++i) {
+            Entry &entry = changed[i];
+            // Broken torrent has no entry, even if the old one was fine
+            if (!remove(entry.path)) {
+                db.rollback();
+                return false;
+            }
+
+            if (!entry.ok) {
+                _failed++;
+                continue;
+            }
+
+            const TorrentSummary &summary = entry.summary;
+            insertTorrent.addBindValue(entry.path);
+            insertTorrent.addBindValue(entry.size);
+            insertTorrent.addBindValue(entry.mtime);
+            insertTorrent.addBindValue(summary.infoHash);
+            insertTorrent.addBindValue(summary.name);
+            insertTorrent.addBindValue(summary.totalSize);
+            insertTorrent.addBindValue(summary.pieceSize);
+            insertTorrent.addBindValue(summary.files.size());
+            insertTorrent.addBindValue(summary.privateTorrent ? 1 : 0);
+            insertTorrent.addBindValue(summary.trackers.join(QStringLiteral(" ")));
+            if (!exec(insertTorrent, errorString)) {
+                db.rollback();
+                return false;
+            }
+
+            QVariant torrentId = insertTorrent.lastInsertId();
+            for (const auto &file: summary.files) {
+                QString path = file.first.isEmpty() ? summary.name : file.first;
+                insertFile.addBindValue(torrentId);
+                insertFile.addBindValue(path);
+                insertFile.addBindValue(path.section(QLatin1Char('/'), -1));
+                insertFile.addBindValue(file.second);
+                if (!exec(insertFile, errorString)) {
+                    db.rollback();
+                    return false;
+                }
+            }
+
+            // Summary is not needed anymore
+            entry.summary = TorrentSummary();
+            _indexed++;
+        }
+
+        if (!db.commit())
+            return setError(db.lastError(), errorString);
+    }
+
+    // Torrents which were deleted from disk
+    db.transaction();
+    for (auto it = known.constBegin(); it != known.constEnd(); ++it) {
+        if (seen.contains(it.key()) || QFileInfo(it.key()).exists())
+            continue;
+
+        if (!remove(it.key())) {
+            db.rollback();
+            return false;
+        }
+        _removed++;
+    }
+
+    return db.commit() || setError(db.lastError(), errorString);
+}
+
+bool TorrentCatalog::findFiles(const QString &namePattern, qlonglong size, QList<Match> &matches, QString *errorString)
+{
+    QString sql = QStringLiteral("SELECT t.path, t.name, t.infohash, f.path, f.size FROM files f JOIN torrents t ON t.id = f.torrent_id WHERE 1");
+    if (!namePattern.isEmpty())
+        sql += QStringLiteral(" AND f.name LIKE ? ESCAPE '\\'");
+    if (size >= 0)
+        sql += QStringLiteral(" AND f.size = ?");
+    sql += QStringLiteral(" ORDER BY t.path, f.path");
+
+    QSqlQuery query(QSqlDatabase::database(_connectionName, false));
+    query.setForwardOnly(true);
+    query.prepare(sql);
+    if (!namePattern.isEmpty())
+        query.addBindValue(likePattern(namePattern));
+    if (size >= 0)
+        query.addBindValue(size);
+
+    if (!exec(query, errorString))
+        return false;
+
+    while (query.next()) {
+        Match match;
+        match.torrentPath = query.value(0).toString();
+        match.name = query.value(1).toString();
+        match.infoHash = query.value(2).toString();
+        match.filePath = query.value(3).toString();
+        match.fileSize = query.value(4).toLongLong();
+        matches << match;
+    }
+    return true;
+}
+
+int TorrentCatalog::indexed() const
+{
+    return _indexed;
+}
+
+int TorrentCatalog::unchanged() const
+{
+    return _unchanged;
+}
+
+int TorrentCatalog::removed() const
+{
+    return _removed;
+}
+
+int TorrentCatalog::failed() const
+{
+    return _failed;
+}
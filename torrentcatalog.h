@@ -0,0 +1,72 @@
+/*
+ * This is an open source non-commercial project. Dear PVS-Studio, please check it.
+ * PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+ *
+ * Copyright (C) 2019  Ivan Romanov <drizt72@zoho.eu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#pragma once
+
+#include "batch.h"
+
+#include <QList>
+#include <QString>
+
+// Local SQLite database of torrents, their files and file sizes.
+// Only new and changed (by size or mtime) files are parsed on update.
+class TorrentCatalog
+{
+public:
+    struct Match
+    {
+        QString torrentPath;
+        QString name;
+        QString infoHash;
+        QString filePath;
+        qlonglong fileSize;
+    };
+
+    TorrentCatalog();
+    ~TorrentCatalog();
+
+    // Creates database and tables if needed
+    bool open(const QString &fileName, QString *errorString = nullptr);
+
+    // Parses new and changed inputs on a thread pool. Entries of deleted
+    // torrents are removed.
+    bool update(const QList<Batch::Input> &inputs, int threadCount, QString *errorString = nullptr);
+
+    // Files which name matches the wildcard pattern and which size is
+    // equal to size. Empty pattern or negative size are not checked.
+    bool findFiles(const QString &namePattern, qlonglong size, QList<Match> &matches, QString *errorString = nullptr);
+
+    // Statistics of the last update
+    int indexed() const;
+    int unchanged() const;
+    int removed() const;
+    int failed() const;
+
+private:
+    Q_DISABLE_COPY(TorrentCatalog)
+
+    QString _connectionName;
+    int _indexed;
+    int _unchanged;
+    int _removed;
+    int _failed;
+};
@@ -0,0 +1,190 @@
+/*
+ * This is an open source non-commercial project. Dear PVS-Studio, please check it.
+ * PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+ *
+ * Copyright (C) 2019  Ivan Romanov <drizt72@zoho.eu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "torrentcreator.h"
+#include "bencodemodel.h"
+#include "worker.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QPair>
+
+TorrentCreator::TorrentCreator(QObject *parent)
+    : QObject(parent)
+    , _pieceSize(0)
+    , _privateTorrent(false)
+    , _threadCount(0)
+    , _usedPieceSize(0)
+    , _totalSize(0)
+{
+}
+
+void TorrentCreator::setPath(const QString &path)
+{
+    _path = path;
+}
+
+void TorrentCreator::setPieceSize(qulonglong pieceSize)
+{
+    _pieceSize = pieceSize;
+}
+
+void TorrentCreator::setTrackers(const QStringList &trackers)
+{
+    _trackers = trackers;
+}
+
+void TorrentCreator::setPrivateTorrent(bool privateTorrent)
+{
+    _privateTorrent = privateTorrent;
+}
+
+void TorrentCreator::setComment(const QString &comment)
+{
+    _comment = comment;
+}
+
+void TorrentCreator::setCreatedBy(const QString &createdBy)
+{
+    _createdBy = createdBy;
+}
+
+void TorrentCreator::setThreadCount(int threadCount)
+{
+    _threadCount = threadCount;
+}
+
+void TorrentCreator::setProgressFunction(const ProgressFunction &progressFunction)
+{
+    _progressFunction = progressFunction;
+}
+
+QByteArray TorrentCreator::create(QString *errorString)
+{
+    QFileInfo pathInfo(_path);
+    if (!pathInfo.exists()) {
+        if (errorString)
+            *errorString = tr("%1 is not exist").arg(QDir::toNativeSeparators(_path));
+        return QByteArray();
+    }
+
+    // Same layout as files added to the files tab
+    QStringList files;
+    QDir baseDir(pathInfo.absoluteFilePath());
+    if (pathInfo.isDir()) {
+        QDirIterator it(pathInfo.absoluteFilePath(), QDirIterator::Subdirectories);
+        while (it.hasNext()) {
+            it.next();
+            QFileInfo fileInfo = it.fileInfo();
+
+            if (fileInfo.isFile())
+                files << fileInfo.absoluteFilePath();
+        }
+        files.sort();
+    }
+    else {
+        files << pathInfo.absoluteFilePath();
+    }
+
+    if (files.isEmpty()) {
+        if (errorString)
+            *errorString = tr("No files in %1").arg(QDir::toNativeSeparators(_path));
+        return QByteArray();
+    }
+
+    QList<QPair<QString, qlonglong>> filePairs;
+    _totalSize = 0;
+    for (const QString &file: files) {
+        qint64 size = Worker::fileSize(file);
+        _totalSize += size;
+        filePairs << QPair<QString, qlonglong>(pathInfo.isDir() ? baseDir.relativeFilePath(file) : QString(), size);
+    }
+
+    _usedPieceSize = _pieceSize ? _pieceSize : Worker::autoPieceSize(_totalSize);
+
+    Worker worker;
+    worker.setThreadCount(_threadCount);
+    connect(&worker, SIGNAL(progress(int)), SLOT(updateProgress(int)));
+    connect(&worker, SIGNAL(resultReady(const QByteArray&, const QString&)), SLOT(setPieces(const QByteArray&, const QString&)));
+
+    // Direct connections. Result is set when doWork() returns.
+    _pieces.clear();
+    _errorString.clear();
+    worker.doWork(files, static_cast<int>(_usedPieceSize));
+
+    if (!_errorString.isEmpty() || _pieces.isEmpty()) {
+        if (errorString)
+            *errorString = _errorString.isEmpty() ? tr("Can't calculate piece hashes") : _errorString;
+        return QByteArray();
+    }
+
+    if (_progressFunction)
+        _progressFunction(_totalSize, _totalSize);
+
+    BencodeModel model;
+    model.setUndoLimit(0);
+    model.setCreationTime(QDateTime::currentDateTime());
+    model.setPieceSize(static_cast<int>(_usedPieceSize));
+    // One file is a single file torrent named after the file, as in the GUI
+    model.setName(files.size() == 1 ? QFileInfo(files.first()).fileName() : pathInfo.fileName());
+    model.setFiles(filePairs);
+    model.setPieces(_pieces);
+    model.setPrivateTorrent(_privateTorrent);
+    if (!_trackers.isEmpty())
+        model.setTrackers(_trackers);
+    if (!_comment.isEmpty())
+        model.setComment(_comment);
+    if (!_createdBy.isEmpty())
+        model.setCreatedBy(_createdBy);
+
+    _hash = model.hash();
+    return model.toRaw();
+}
+
+QString TorrentCreator::hash() const
+{
+    return _hash;
+}
+
+qulonglong TorrentCreator::pieceSize() const
+{
+    return _usedPieceSize;
+}
+
+qint64 TorrentCreator::totalSize() const
+{
+    return _totalSize;
+}
+
+void TorrentCreator::updateProgress(int value)
+{
+    if (_progressFunction)
+        _progressFunction(qMin<qint64>(static_cast<qint64>(value) * 1024, _totalSize), _totalSize);
+}
+
+void TorrentCreator::setPieces(const QByteArray &pieces, const QString &errorString)
+{
+    _pieces = pieces;
+    _errorString = errorString;
+}
@@ -0,0 +1,81 @@
+/*
+ * This is an open source non-commercial project. Dear PVS-Studio, please check it.
+ * PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+ *
+ * Copyright (C) 2019  Ivan Romanov <drizt72@zoho.eu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#pragma once
+
+#include <QObject>
+#include <QStringList>
+#include <QByteArray>
+
+#include <functional>
+
+// Makes a torrent from a file or a folder without GUI.
+// Pieces are hashed by Worker in the calling thread.
+class TorrentCreator : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Hashed and total bytes
+    typedef std::function<void(qint64 done, qint64 total)> ProgressFunction;
+
+    explicit TorrentCreator(QObject *parent = nullptr);
+
+    void setPath(const QString &path);
+    // 0 means Worker::autoPieceSize()
+    void setPieceSize(qulonglong pieceSize);
+    // Each tracker is a separate tier
+    void setTrackers(const QStringList &trackers);
+    void setPrivateTorrent(bool privateTorrent);
+    void setComment(const QString &comment);
+    void setCreatedBy(const QString &createdBy);
+    void setThreadCount(int threadCount);
+    void setProgressFunction(const ProgressFunction &progressFunction);
+
+    // Returns raw torrent or empty array on error
+    QByteArray create(QString *errorString = nullptr);
+
+    // Valid after successful create()
+    QString hash() const;
+    qulonglong pieceSize() const;
+    qint64 totalSize() const;
+
+private slots:
+    void updateProgress(int value);
+    void setPieces(const QByteArray &pieces, const QString &errorString);
+
+private:
+    QString _path;
+    qulonglong _pieceSize;
+    QStringList _trackers;
+    bool _privateTorrent;
+    QString _comment;
+    QString _createdBy;
+    int _threadCount;
+    ProgressFunction _progressFunction;
+
+    QByteArray _pieces;
+    QString _errorString;
+    QString _hash;
+    qulonglong _usedPieceSize;
+    qint64 _totalSize;
+};
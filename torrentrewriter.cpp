@@ -0,0 +1,236 @@
+/*
+ * This is an open source non-commercial project. Dear PVS-Studio, please check it.
+ * PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+ *
+ * Copyright (C) 2019  Ivan Romanov <drizt72@zoho.eu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "torrentrewriter.h"
+#include "bencode.h"
+
+#include <QCryptographicHash>
+#include <QFile>
+#include <QMap>
+
+#ifdef HAVE_QT5
+# include <QSaveFile>
+#endif
+
+namespace {
+
+typedef QMap<QByteArray, QByteArray> RawValues;
+
+QByteArray rawString(const QString &string)
+{
+    return Bencode(string.toUtf8()).toRaw();
+}
+
+// List of strings or list of single string lists
+QByteArray rawList(const QStringList &strings, bool tiers)
+{
+    Bencode list(Bencode::Type::List);
+    for (const QString &string: strings) {
+        Bencode *item = new Bencode(string.toUtf8());
+        if (tiers) {
+            Bencode *tier = new Bencode(Bencode::Type::List);
+            tier->appendChild(item);
+            item = tier;
+        }
+        list.appendChild(item);
+    }
+    return list.toRaw();
+}
+
+void appendItem(QByteArray &res, const QByteArray &key, const QByteArray &value)
+{
+    res += QByteArray::number(key.size());
+    res += ':';
+    res += key;
+    res += value;
+}
+
+// Rebuilds dictionary [pos, end). Values replace items with the same key or are
+// inserted before the first greater key. Empty value removes item.
+// Other items are copied as is.
+QByteArray spliceDictionary(const QByteArray &raw, int pos, int end, const QList<Bencode::RawSpan> &spans, const RawValues &values)
+{
+    RawValues inserted;
+    for (auto it = values.constBegin(); it != values.constEnd(); ++it) {
+        if (!it.value().isEmpty() && !Bencode::findSpan(spans, it.key()))
+            inserted.insert(it.key(), it.value());
+    }
+
+    QByteArray res;
+    res.reserve(end - pos);
+    res += 'd';
+    for (const Bencode::RawSpan &span: spans) {
+        while (!inserted.isEmpty() && inserted.firstKey() < span.key) {
+            appendItem(res, inserted.firstKey(), inserted.first());
+            inserted.erase(inserted.begin());
+        }
+
+        auto value = values.constFind(span.key);
+        if (value == values.constEnd())
+            res += raw.mid(span.keyBegin, span.end - span.keyBegin);
+        else if (!value.value().isEmpty())
+            appendItem(res, span.key, value.value());
+    }
+
+    for (auto it = inserted.constBegin(); it != inserted.constEnd(); ++it) {
+        appendItem(res, it.key(), it.value());
+    }
+    res += 'e';
+    return res;
+}
+
+} // namespace
+
+TorrentRewriter::TorrentRewriter()
+    : _edits(0)
+    , _privateTorrent(false)
+{
+}
+
+void TorrentRewriter::setTrackers(const QStringList &trackers)
+{
+    _edits |= Trackers;
+    _trackers = trackers;
+}
+
+void TorrentRewriter::setPrivateTorrent(bool privateTorrent)
+{
+    _edits |= Private;
+    _privateTorrent = privateTorrent;
+}
+
+void TorrentRewriter::setComment(const QString &comment)
+{
+    _edits |= Comment;
+    _comment = comment;
+}
+
+void TorrentRewriter::setCreatedBy(const QString &createdBy)
+{
+    _edits |= CreatedBy;
+    _createdBy = createdBy;
+}
+
+void TorrentRewriter::setUrlList(const QStringList &urls)
+{
+    _edits |= UrlList;
+    _urlList = urls;
+}
+
+bool TorrentRewriter::hasEdits() const
+{
+    return _edits;
+}
+
+bool TorrentRewriter::rewrite(const QByteArray &raw, QByteArray &result, QString *errorString) const
+{
+    QList<Bencode::RawSpan> spans;
+    int end;
+    if (!Bencode::dictionarySpans(raw, spans, 0, &end)) {
+        if (errorString)
+            *errorString = QStringLiteral("can't parse bencode format");
+        return false;
+    }
+
+    RawValues values;
+    if (_edits & Trackers) {
+        values.insert("announce", _trackers.isEmpty() ? QByteArray() : rawString(_trackers.first()));
+        values.insert("announce-list", _trackers.isEmpty() ? QByteArray() : rawList(_trackers, true));
+    }
+
+    if (_edits & Comment)
+        values.insert("comment", _comment.isEmpty() ? QByteArray() : rawString(_comment));
+
+    if (_edits & CreatedBy)
+        values.insert("created by", _createdBy.isEmpty() ? QByteArray() : rawString(_createdBy));
+
+    if (_edits & UrlList)
+        values.insert("url-list", _urlList.isEmpty() ? QByteArray() : rawList(_urlList, false));
+
+    // Private flag is inside info. Info is rebuilt only if the flag is changed.
+    const Bencode::RawSpan *info = Bencode::findSpan(spans, "info");
+    if ((_edits & Private) && info) {
+        QList<Bencode::RawSpan> infoSpans;
+        int infoEnd;
+        if (!Bencode::dictionarySpans(raw, infoSpans, info->begin, &infoEnd)) {
+            if (errorString)
+                *errorString = QStringLiteral("can't parse info");
+            return false;
+        }
+
+        const Bencode::RawSpan *privateSpan = Bencode::findSpan(infoSpans, "private");
+        bool isPrivate = privateSpan && raw.mid(privateSpan->begin, privateSpan->end - privateSpan->begin) == "i1e";
+        if (isPrivate != _privateTorrent) {
+            RawValues infoValues;
+            infoValues.insert("private", _privateTorrent ? QByteArray("i1e") : QByteArray());
+            values.insert("info", spliceDictionary(raw, info->begin, infoEnd, infoSpans, infoValues));
+        }
+    }
+
+    result = spliceDictionary(raw, 0, end, spans, values);
+
+    // Anything after the dictionary is kept too
+    result += raw.mid(end);
+    return true;
+}
+
+QString TorrentRewriter::infoHash(const QByteArray &raw)
+{
+    QList<Bencode::RawSpan> spans;
+    const Bencode::RawSpan *info = Bencode::dictionarySpans(raw, spans) ? Bencode::findSpan(spans, "info") : nullptr;
+    if (!info)
+        return QString();
+
+    QByteArray infoRaw = QByteArray::fromRawData(raw.constData() + info->begin, info->end - info->begin);
+    return QString::fromLatin1(QCryptographicHash::hash(infoRaw, QCryptographicHash::Sha1).toHex());
+}
+
+bool TorrentRewriter::writeFile(const QString &fileName, const QByteArray &data, QString *errorString)
+{
+#ifdef HAVE_QT5
+    QSaveFile file(fileName);
+    if (file.open(QIODevice::WriteOnly) && file.write(data) == data.size() && file.commit())
+        return true;
+#else
+    QString tempName = fileName + QStringLiteral(".tfe-tmp");
+    QFile file(tempName);
+    if (file.open(QIODevice::WriteOnly) && file.write(data) == data.size() && file.flush()) {
+        file.close();
+        // Qt4 can't rename over existing file. Move the original aside so
+        // it is never lost and put it back if the new one can't take its place.
+        QString backupName = fileName + QStringLiteral(".tfe-bak");
+        QFile::remove(backupName);
+        if (QFile::rename(fileName, backupName)) {
+            if (QFile::rename(tempName, fileName)) {
+                QFile::remove(backupName);
+                return true;
+            }
+            QFile::rename(backupName, fileName);
+        }
+    }
+    QFile::remove(tempName);
+#endif
+
+    if (errorString)
+        *errorString = QStringLiteral("can't write %1: %2").arg(fileName, file.errorString());
+    return false;
+}
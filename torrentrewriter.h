@@ -0,0 +1,72 @@
+/*
+ * This is an open source non-commercial project. Dear PVS-Studio, please check it.
+ * PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+ *
+ * Copyright (C) 2019  Ivan Romanov <drizt72@zoho.eu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+// Applies metadata edits to raw torrents. Items which are not edited are
+// copied byte to byte, so the info hash is kept unless info is changed.
+class TorrentRewriter
+{
+public:
+    TorrentRewriter();
+
+    // Each tracker is a separate tier. Empty list removes trackers.
+    void setTrackers(const QStringList &trackers);
+    void setPrivateTorrent(bool privateTorrent);
+    // Empty string removes item
+    void setComment(const QString &comment);
+    void setCreatedBy(const QString &createdBy);
+    // Web seeds. Empty list removes url-list.
+    void setUrlList(const QStringList &urls);
+
+    bool hasEdits() const;
+
+    // Result is equal to raw if nothing was changed
+    bool rewrite(const QByteArray &raw, QByteArray &result, QString *errorString = nullptr) const;
+
+    // SHA1 of info bytes as they are. Empty if there is no info.
+    static QString infoHash(const QByteArray &raw);
+
+    // Writes to a temporary file and renames it over fileName
+    static bool writeFile(const QString &fileName, const QByteArray &data, QString *errorString = nullptr);
+
+private:
+    enum Edit
+    {
+        Trackers = 0x1,
+        Private = 0x2,
+        Comment = 0x4,
+        CreatedBy = 0x8,
+        UrlList = 0x10
+    };
+
+    int _edits;
+    QStringList _trackers;
+    bool _privateTorrent;
+    QString _comment;
+    QString _createdBy;
+    QStringList _urlList;
+};
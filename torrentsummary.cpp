@@ -0,0 +1,135 @@
+/*
+ * This is an open source non-commercial project. Dear PVS-Studio, please check it.
+ * PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+ *
+ * Copyright (C) 2019  Ivan Romanov <drizt72@zoho.eu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "torrentsummary.h"
+#include "bencode.h"
+
+#include <QCryptographicHash>
+#include <QScopedPointer>
+
+namespace {
+
+// Parses only the value of span
+Bencode *parseSpan(const QByteArray &raw, const Bencode::RawSpan &span)
+{
+    return Bencode::fromRaw(QByteArray::fromRawData(raw.constData() + span.begin, span.end - span.begin));
+}
+
+QString stringValue(const QByteArray &raw, const Bencode::RawSpan *span)
+{
+    if (!span)
+        return QString();
+
+    QScopedPointer<Bencode> item(parseSpan(raw, *span));
+    return QString::fromUtf8(item->string());
+}
+
+qlonglong integerValue(const QByteArray &raw, const Bencode::RawSpan *span)
+{
+    if (!span)
+        return 0;
+
+    QScopedPointer<Bencode> item(parseSpan(raw, *span));
+    return item->integer();
+}
+
+QString filePath(const Bencode *path)
+{
+    QStringList parts;
+    if (path && path->isList()) {
+        for (int i = 0; i < path->childCount(); ++i) {
+            parts << QString::fromUtf8(path->child(i)->string());
+        }
+    }
+    return parts.join(QStringLiteral("/"));
+}
+
+} // namespace
+
+TorrentSummary::TorrentSummary()
+    : totalSize(0)
+    , pieceSize(0)
+    , privateTorrent(false)
+{
+}
+
+bool TorrentSummary::fromRaw(const QByteArray &raw, TorrentSummary &summary, QString *errorString)
+{
+    summary = TorrentSummary();
+
+    QList<Bencode::RawSpan> spans;
+    if (!Bencode::dictionarySpans(raw, spans)) {
+        if (errorString)
+            *errorString = QStringLiteral("can't parse bencode format");
+        return false;
+    }
+
+    const Bencode::RawSpan *info = Bencode::findSpan(spans, "info");
+    QList<Bencode::RawSpan> infoSpans;
+    if (!info || !Bencode::dictionarySpans(raw, infoSpans, info->begin)) {
+        if (errorString)
+            *errorString = QStringLiteral("no info dictionary");
+        return false;
+    }
+
+    QByteArray infoRaw = QByteArray::fromRawData(raw.constData() + info->begin, info->end - info->begin);
+    summary.infoHash = QString::fromLatin1(QCryptographicHash::hash(infoRaw, QCryptographicHash::Sha1).toHex());
+
+    const Bencode::RawSpan *name = Bencode::findSpan(infoSpans, "name.utf-8");
+    summary.name = stringValue(raw, name ? name : Bencode::findSpan(infoSpans, "name"));
+    summary.pieceSize = integerValue(raw, Bencode::findSpan(infoSpans, "piece length"));
+    summary.privateTorrent = integerValue(raw, Bencode::findSpan(infoSpans, "private")) == 1;
+
+    const Bencode::RawSpan *files = Bencode::findSpan(infoSpans, "files");
+    if (files) {
+        QScopedPointer<Bencode> list(parseSpan(raw, *files));
+        for (int i = 0; i < list->childCount(); ++i) {
+            const Bencode *file = list->child(i);
+            const Bencode *path = file->child("path.utf-8");
+            qlonglong length = file->child("length") ? file->child("length")->integer() : 0;
+            summary.files << QPair<QString, qlonglong>(filePath(path ? path : file->child("path")), length);
+            summary.totalSize += length;
+        }
+    }
+    else {
+        summary.totalSize = integerValue(raw, Bencode::findSpan(infoSpans, "length"));
+        summary.files << QPair<QString, qlonglong>(QString(), summary.totalSize);
+    }
+
+    // Trackers of all tiers. announce is first if it's not in the list.
+    const Bencode::RawSpan *announceList = Bencode::findSpan(spans, "announce-list");
+    if (announceList) {
+        QScopedPointer<Bencode> tiers(parseSpan(raw, *announceList));
+        for (int i = 0; i < tiers->childCount(); ++i) {
+            const Bencode *tier = tiers->child(i);
+            for (int j = 0; j < tier->childCount(); ++j) {
+                summary.trackers << QString::fromUtf8(tier->child(j)->string());
+            }
+        }
+    }
+
+    QString announce = stringValue(raw, Bencode::findSpan(spans, "announce"));
+    if (!announce.isEmpty() && !summary.trackers.contains(announce))
+        summary.trackers.prepend(announce);
+
+    return true;
+}
@@ -0,0 +1,50 @@
+/*
+ * This is an open source non-commercial project. Dear PVS-Studio, please check it.
+ * PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+ *
+ * Copyright (C) 2019  Ivan Romanov <drizt72@zoho.eu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#pragma once
+
+#include <QByteArray>
+#include <QList>
+#include <QPair>
+#include <QString>
+#include <QStringList>
+
+// Catalog fields of a torrent. Read without building the whole tree:
+// pieces and other unneeded values are only skipped.
+struct TorrentSummary
+{
+    TorrentSummary();
+
+    // Returns false if raw is not a torrent
+    static bool fromRaw(const QByteArray &raw, TorrentSummary &summary, QString *errorString = nullptr);
+
+    // SHA1 of info bytes as they are in the file
+    QString infoHash;
+    QString name;
+    qlonglong totalSize;
+    qlonglong pieceSize;
+    bool privateTorrent;
+    QStringList trackers;
+    // Path inside torrent and size. Single file torrent has one file
+    // with empty path.
+    QList<QPair<QString, qlonglong>> files;
+};
@@ -0,0 +1,206 @@
+/*
+ * This is an open source non-commercial project. Dear PVS-Studio, please check it.
+ * PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+ *
+ * Copyright (C) 2019  Ivan Romanov <drizt72@zoho.eu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "worker.h"
+#include "functiontask.h"
+
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QList>
+#include <QSemaphore>
+#include <QThread>
+#include <QThreadPool>
+#include <qmath.h>
+
+#ifdef Q_OS_WIN
+# include <io.h>
+# include <windows.h>
+#endif
+
+#define PROGRESS_TIMEOUT 500 /* ms */
+
+Worker::Worker()
+    : QObject()
+    , _isCanceled(false)
+    , _threadCount(0)
+{
+}
+
+void Worker::setThreadCount(int threadCount)
+{
+    _threadCount = threadCount;
+}
+
+int Worker::threadCount() const
+{
+    return _threadCount > 0 ? _threadCount : QThread::idealThreadCount();
+}
+
+QList<qulonglong> Worker::pieceSizes()
+{
+    QList<qulonglong> sizes;
+    for (int i = 5; i < 16; ++i) {
+        sizes << 1024 * static_cast<qulonglong>(qPow(2, i));
+    }
+    return sizes;
+}
+
+qulonglong Worker::autoPieceSize(qulonglong totalSize)
+{
+    // http://torrentfreak.com/how-to-make-the-best-torrents-081121/
+    // Find out optimal piece size
+    qulonglong pieceSize = 0;
+    for (qulonglong size: pieceSizes()) {
+        pieceSize = size;
+        if (totalSize / pieceSize < 2000)
+            break;
+    }
+    return pieceSize;
+}
+
+// FIXME: workaround for symlink wrong size https://bugreports.qt.io/browse/QTBUG-24831
+qint64 Worker::fileSize(const QString &path)
+{
+#ifdef Q_OS_UNIX
+    return QFileInfo(path).size();
+#else
+    QFileInfo fi(path);
+    if (!fi.isSymLink()) {
+        return fi.size();
+    }
+    else {
+        QFile file(path);
+        file.open(QFile::ReadOnly); // it must be open to get a windows file handle
+        HANDLE hFile = reinterpret_cast<HANDLE>(_get_osfhandle(file.handle()));
+        DWORD size = GetFileSize(hFile, nullptr);
+        file.close();
+        return static_cast<qint64>(size);
+    }
+#endif
+}
+
+void Worker::doWork(const QStringList &files, int pieceSize)
+{
+    const int threads = threadCount();
+    QThreadPool pool;
+    pool.setMaxThreadCount(threads);
+    // Limits memory of pieces waiting to be hashed
+    QSemaphore freeSlots(threads * 2);
+
+    // Hashes are filled in by pool threads
+    QList<QByteArray*> hashes;
+    auto finish = [&pool, &hashes, this](const QString &errorString) {
+        pool.waitForDone();
+        QByteArray pieceHashes;
+        if (errorString.isEmpty() && !_isCanceled) {
+            pieceHashes.reserve(hashes.size() * 20);
+            for (const QByteArray *hash: hashes) {
+                pieceHashes += *hash;
+            }
+        }
+        qDeleteAll(hashes);
+        emit resultReady(pieceHashes, errorString);
+    };
+
+    QByteArray piece;
+    int piecePos = 0;
+    piece.resize(pieceSize);
+
+    qulonglong value = 0;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    for (int i = 0; i < files.size(); ++i) {
+        QFile f(files[i]);
+        if (!f.open(QIODevice::ReadOnly)) {
+            finish(QString(tr("Can't open %1")).arg(QDir::toNativeSeparators(files[i])));
+            return;
+        }
+
+        int readed;
+        int j = 0;
+        while ((readed = f.read(piece.data() + piecePos, pieceSize - piecePos)) > 0) {  // -V104 PVS-Studio
+            piecePos += readed;
+            j++;
+            if (piecePos == pieceSize || ((i == files.size() - 1) && f.atEnd())) {
+                piece.resize(piecePos);
+                piecePos = 0;
+
+                QByteArray *hash = new QByteArray;
+                hashes << hash;
+                if (threads == 1) {
+                    *hash = QCryptographicHash::hash(piece, QCryptographicHash::Sha1);
+                }
+                else {
+                    // Task takes the buffer. So next piece is read to a new one.
+                    freeSlots.acquire();
+                    pool.start(makeTask([piece, hash, &freeSlots]() mutable {
+                        *hash = QCryptographicHash::hash(piece, QCryptographicHash::Sha1);
+                        piece = QByteArray();
+                        freeSlots.release();
+                    }));
+                    piece = QByteArray();
+                    piece.resize(pieceSize);
+                }
+            }
+            value += readed;
+
+            // Do not send progress signal very often. It can leads to crash.
+            if (timer.hasExpired(PROGRESS_TIMEOUT)) {
+                emit progress(value / 1024);
+                timer.restart();
+            }
+
+            QCoreApplication::processEvents();
+            if (_isCanceled) {
+                f.close();
+                finish(QString());
+                return;
+            }
+
+            if (f.atEnd()) {
+                break;
+            }
+        }
+
+        // Some error
+        if (readed < 0) {
+            f.close();
+            finish(QString(tr("Can't read from %1")).arg(QDir::toNativeSeparators(files[i])));
+            return;
+        }
+
+        f.close();
+    }
+
+    finish(QString());
+}
+
+void Worker::cancel()
+{
+    _isCanceled = true;
+}
@@ -0,0 +1,60 @@
+/*
+ * This is an open source non-commercial project. Dear PVS-Studio, please check it.
+ * PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+ *
+ * Copyright (C) 2019  Ivan Romanov <drizt72@zoho.eu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#pragma once
+
+#include <QObject>
+#include <QStringList>
+#include <QByteArray>
+#include <QList>
+
+// Calculates piece hashes of files. Lives in its own thread.
+class Worker : public QObject
+{
+    Q_OBJECT
+
+public:
+    Worker();
+
+    // Threads to hash pieces. Files are always read by one thread.
+    // 0 means QThread::idealThreadCount(). Set before doWork().
+    void setThreadCount(int threadCount);
+    int threadCount() const;
+
+    // Piece sizes offered to user, from 32 KiB to 32 MiB
+    static QList<qulonglong> pieceSizes();
+    // Smallest piece size giving less than 2000 pieces
+    static qulonglong autoPieceSize(qulonglong totalSize);
+    static qint64 fileSize(const QString &path);
+
+public slots:
+    void doWork(const QStringList &files, int pieceSize);
+    void cancel();
+
+signals:
+    void progress(int value);
+    void resultReady(const QByteArray &result, const QString &errorString);
+
+private:
+    bool _isCanceled;
+    int _threadCount;
+};